@@ -0,0 +1,124 @@
+﻿#include "typed_count_core.h"
+
+#include <cstdint>
+
+// Pairs of typed_<name> and raw_<name> functions which compare_codegen.cmake asserts to
+// compile to identical assembly, apart from local label numbers.
+
+using namespace typed_count;
+
+//! what a safe_array is passed as: a pointer and count pair.
+template <typename T>
+struct raw_array
+{
+	T* data;
+	std::size_t count;
+};
+
+extern "C"
+{
+
+std::size_t typed_add(char_count lhs, char_count rhs)
+{
+	return (lhs + rhs - 1_ch).to_size();
+}
+
+std::size_t raw_add(std::size_t lhs, std::size_t rhs)
+{
+	return lhs + rhs - 1;
+}
+
+bool typed_less(wchar_count lhs, wchar_count rhs)
+{
+	return lhs < rhs;
+}
+
+bool raw_less(std::size_t lhs, std::size_t rhs)
+{
+	return lhs < rhs;
+}
+
+std::size_t typed_wchar_to_bytes(wchar_count count)
+{
+	return count.to_count_of<std::byte>().to_size();
+}
+
+std::size_t raw_wchar_to_bytes(std::size_t count)
+{
+	return count * sizeof(wchar_t);
+}
+
+std::size_t typed_bytes_to_pages(byte_count count)
+{
+	return count.to_count_of<Page>().to_size();
+}
+
+std::size_t raw_bytes_to_pages(std::size_t count)
+{
+	return count / (8 * 1024);
+}
+
+std::size_t typed_pages_to_kb(page_count count)
+{
+	return count.to_count_of<Kb>().to_size();
+}
+
+std::size_t raw_pages_to_kb(std::size_t count)
+{
+	return count * 8;
+}
+
+std::uint32_t typed_sum(safe_array<const std::uint32_t> values)
+{
+	std::uint32_t sum = 0;
+	for (std::uint32_t value : values)
+	{
+		sum += value;
+	}
+	return sum;
+}
+
+std::uint32_t raw_sum(raw_array<const std::uint32_t> values)
+{
+	std::uint32_t sum = 0;
+	for (const std::uint32_t* it = values.data; it != values.data + values.count; ++it)
+	{
+		sum += *it;
+	}
+	return sum;
+}
+
+std::size_t typed_skip(safe_array<const char> input)
+{
+	std::size_t records = 0;
+	while (input.count() >= 16_ch)
+	{
+		records += input[0_ch] == 'x';
+		input += 16_ch;
+	}
+	return records;
+}
+
+std::size_t raw_skip(raw_array<const char> input)
+{
+	std::size_t records = 0;
+	while (input.count >= 16)
+	{
+		records += input.data[0] == 'x';
+		input.data += 16;
+		input.count -= 16;
+	}
+	return records;
+}
+
+std::uint64_t* typed_allocate(count_of<std::uint64_t> count)
+{
+	return make_safe_array(count).data();
+}
+
+std::uint64_t* raw_allocate(std::size_t count)
+{
+	return new std::uint64_t[count];
+}
+
+}
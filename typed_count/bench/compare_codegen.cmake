@@ -0,0 +1,47 @@
+# Asserts that every typed_<name> function in the assembly ASM compiles to the same
+# instructions as raw_<name>. Local label numbers and function names are ignored.
+#
+# cmake -DASM=codegen_check.s -P compare_codegen.cmake
+
+file(STRINGS "${ASM}" lines)
+
+set(current "")
+set(names "")
+foreach(line IN LISTS lines)
+	if(line MATCHES "^(typed|raw)_([A-Za-z0-9_]+):$")
+		set(current "${CMAKE_MATCH_1}_${CMAKE_MATCH_2}")
+		set(body_${current} "")
+		if(CMAKE_MATCH_1 STREQUAL "typed")
+			list(APPEND names "${CMAKE_MATCH_2}")
+		endif()
+	elseif(current STREQUAL "")
+	elseif(line MATCHES "^\t\\.size\t${current},")
+		set(current "")
+	elseif(NOT line MATCHES "^\t\\.(cfi_|p2align)" AND NOT line MATCHES "^\\.LF")
+		string(REGEX REPLACE "\\.L[A-Z]*[0-9]+" ".L" line "${line}")
+		string(REPLACE "${current}" "<function>" line "${line}")
+		string(APPEND body_${current} "${line}\n")
+	endif()
+endforeach()
+
+if(names STREQUAL "")
+	message(FATAL_ERROR "no typed_ functions found in ${ASM}")
+endif()
+
+set(failed "")
+foreach(name IN LISTS names)
+	if(NOT DEFINED body_raw_${name})
+		message(SEND_ERROR "raw_${name} is missing")
+		list(APPEND failed "${name}")
+	elseif(NOT body_typed_${name} STREQUAL body_raw_${name})
+		message(SEND_ERROR "typed_${name} differs from raw_${name}\n"
+			"typed_${name}:\n${body_typed_${name}}\nraw_${name}:\n${body_raw_${name}}")
+		list(APPEND failed "${name}")
+	else()
+		message(STATUS "${name}: identical")
+	endif()
+endforeach()
+
+if(failed)
+	message(FATAL_ERROR "typed code differs from raw code: ${failed}")
+endif()
@@ -0,0 +1,370 @@
+﻿#include "typed_count_core.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Each benchmark has a typed version and a raw version doing the same work with size_t and
+// pointers. Zero cost means both report the same time per item.
+
+using namespace typed_count;
+
+namespace
+{
+
+constexpr std::size_t batch = 1024;
+
+template <typename T>
+constexpr const char* unit_name = "";
+template <> constexpr const char* unit_name<std::byte> = "byte";
+template <> constexpr const char* unit_name<char> = "char";
+template <> constexpr const char* unit_name<wchar_t> = "wchar_t";
+template <> constexpr const char* unit_name<Page> = "Page";
+template <> constexpr const char* unit_name<Kb> = "Kb";
+template <> constexpr const char* unit_name<Mb> = "Mb";
+template <> constexpr const char* unit_name<Gb> = "Gb";
+template <> constexpr const char* unit_name<Tb> = "Tb";
+
+template <typename... T>
+struct unit_list
+{};
+
+using units = unit_list<std::byte, char, wchar_t, Page, Kb, Mb, Gb, Tb>;
+
+//! returns batch pseudo-random sizes below 2^32, the same on every run.
+std::vector<std::size_t> make_sizes()
+{
+	std::mt19937_64 random(42);
+	std::vector<std::size_t> sizes(batch);
+	for (std::size_t& size : sizes)
+	{
+		size = random() >> 32;
+	}
+	return sizes;
+}
+
+template <typename T>
+std::vector<count_of<T>> make_counts()
+{
+	std::vector<count_of<T>> counts;
+	for (std::size_t size : make_sizes())
+	{
+		counts.push_back(count_of<T>(size));
+	}
+	return counts;
+}
+
+void typed_arithmetic(benchmark::State& state)
+{
+	const auto counts = make_counts<char>();
+	const char_count header(16);
+	const char_count trailer(4);
+	for (auto _ : state)
+	{
+		char_count total;
+		for (char_count count : counts)
+		{
+			total += count + header - trailer;
+			++total;
+		}
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+}
+
+void raw_arithmetic(benchmark::State& state)
+{
+	const auto sizes = make_sizes();
+	const std::size_t header = 16;
+	const std::size_t trailer = 4;
+	for (auto _ : state)
+	{
+		std::size_t total = 0;
+		for (std::size_t size : sizes)
+		{
+			total += size + header - trailer;
+			++total;
+		}
+		benchmark::DoNotOptimize(total);
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+}
+
+void typed_comparison(benchmark::State& state)
+{
+	const auto counts = make_counts<char>();
+	const char_count threshold(std::size_t(1) << 31);
+	for (auto _ : state)
+	{
+		std::size_t below = 0;
+		char_count largest;
+		for (char_count count : counts)
+		{
+			below += count < threshold;
+			largest = largest < count ? count : largest;
+		}
+		benchmark::DoNotOptimize(below);
+		benchmark::DoNotOptimize(largest);
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+}
+
+void raw_comparison(benchmark::State& state)
+{
+	const auto sizes = make_sizes();
+	const std::size_t threshold = std::size_t(1) << 31;
+	for (auto _ : state)
+	{
+		std::size_t below = 0;
+		std::size_t largest = 0;
+		for (std::size_t size : sizes)
+		{
+			below += size < threshold;
+			largest = largest < size ? size : largest;
+		}
+		benchmark::DoNotOptimize(below);
+		benchmark::DoNotOptimize(largest);
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+}
+
+template <typename From, typename To>
+void typed_to_count_of(benchmark::State& state)
+{
+	const auto counts = make_counts<From>();
+	for (auto _ : state)
+	{
+		for (count_of<From> count : counts)
+		{
+			auto converted = count.template to_count_of<To>();
+			benchmark::DoNotOptimize(converted);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+}
+
+//! converts by the unit sizes reduced by hand, like careful code without count_of does.
+template <typename From, typename To>
+void raw_to_count_of(benchmark::State& state)
+{
+	using ratio_t = unit_conversion_t<From, To>;
+	const auto sizes = make_sizes();
+	for (auto _ : state)
+	{
+		for (std::size_t size : sizes)
+		{
+			std::size_t converted = size * std::size_t(ratio_t::num) / std::size_t(ratio_t::den);
+			benchmark::DoNotOptimize(converted);
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * batch);
+}
+
+template <typename From, typename... To>
+void register_conversions_from(unit_list<To...>)
+{
+	const std::string prefix = std::string("/") + unit_name<From> + "/";
+	(benchmark::RegisterBenchmark(("typed_to_count_of" + prefix + unit_name<To>).c_str(), typed_to_count_of<From, To>), ...);
+	(benchmark::RegisterBenchmark(("raw_to_count_of" + prefix + unit_name<To>).c_str(), raw_to_count_of<From, To>), ...);
+}
+
+template <typename... From>
+void register_conversions(unit_list<From...>)
+{
+	(register_conversions_from<From>(units()), ...);
+}
+
+void typed_iteration(benchmark::State& state)
+{
+	std::vector<std::uint32_t> values(static_cast<std::size_t>(state.range(0)), 1);
+	const safe_array<const std::uint32_t> array(values.data(), values.size());
+	for (auto _ : state)
+	{
+		std::uint32_t sum = 0;
+		for (std::uint32_t value : array)
+		{
+			sum += value;
+		}
+		for (auto i : array.indices())
+		{
+			sum ^= array[i];
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void raw_iteration(benchmark::State& state)
+{
+	std::vector<std::uint32_t> values(static_cast<std::size_t>(state.range(0)), 1);
+	const std::uint32_t* const p = values.data();
+	const std::size_t n = values.size();
+	for (auto _ : state)
+	{
+		std::uint32_t sum = 0;
+		for (const std::uint32_t* it = p; it != p + n; ++it)
+		{
+			sum += *it;
+		}
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			sum ^= p[i];
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+//! walks records of 16 bytes by operator += like a parser consuming its input.
+void typed_advance(benchmark::State& state)
+{
+	std::vector<char> input(static_cast<std::size_t>(state.range(0)), 'x');
+	for (auto _ : state)
+	{
+		safe_array<const char> rest(input.data(), input.size());
+		std::size_t records = 0;
+		while (rest.count() >= 16_ch)
+		{
+			records += rest[0_ch] == 'x';
+			rest += 16_ch;
+		}
+		benchmark::DoNotOptimize(records);
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void raw_advance(benchmark::State& state)
+{
+	std::vector<char> input(static_cast<std::size_t>(state.range(0)), 'x');
+	for (auto _ : state)
+	{
+		const char* p = input.data();
+		std::size_t n = input.size();
+		std::size_t records = 0;
+		while (n >= 16)
+		{
+			records += p[0] == 'x';
+			p += 16;
+			n -= 16;
+		}
+		benchmark::DoNotOptimize(records);
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+std::string make_string(benchmark::State& state)
+{
+	return std::string(static_cast<std::size_t>(state.range(0)), 'a');
+}
+
+void typed_str_len(benchmark::State& state)
+{
+	const std::string s = make_string(state);
+	for (auto _ : state)
+	{
+		const char* p = s.c_str();
+		benchmark::DoNotOptimize(p);
+		benchmark::DoNotOptimize(str_len_s(p));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void raw_str_len(benchmark::State& state)
+{
+	const std::string s = make_string(state);
+	for (auto _ : state)
+	{
+		const char* p = s.c_str();
+		benchmark::DoNotOptimize(p);
+		benchmark::DoNotOptimize(std::strlen(p));
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void typed_str_cpy(benchmark::State& state)
+{
+	const std::string s = make_string(state);
+	std::vector<char> dest(s.size() + 1);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(str_cpy_s(s.c_str(), dest.data(), char_count(dest.size())));
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+//! copies with the same range check as str_cpy_s().
+void raw_str_cpy(benchmark::State& state)
+{
+	const std::string s = make_string(state);
+	std::vector<char> dest(s.size() + 1);
+	for (auto _ : state)
+	{
+		const std::size_t n = std::strlen(s.c_str());
+		int result = ERANGE;
+		if (n < dest.size())
+		{
+			std::memcpy(dest.data(), s.c_str(), n + 1);
+			result = 0;
+		}
+		benchmark::DoNotOptimize(result);
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void typed_make_safe_array(benchmark::State& state)
+{
+	const count_of<std::uint64_t> count(static_cast<std::size_t>(state.range(0)));
+	for (auto _ : state)
+	{
+		safe_array<std::uint64_t> array = make_safe_array(count);
+		benchmark::DoNotOptimize(array.data());
+		delete[] array.data();
+	}
+}
+
+void raw_make_safe_array(benchmark::State& state)
+{
+	const std::size_t count = static_cast<std::size_t>(state.range(0));
+	for (auto _ : state)
+	{
+		std::uint64_t* p = new std::uint64_t[count];
+		benchmark::DoNotOptimize(p);
+		delete[] p;
+	}
+}
+
+}
+
+BENCHMARK(typed_arithmetic);
+BENCHMARK(raw_arithmetic);
+BENCHMARK(typed_comparison);
+BENCHMARK(raw_comparison);
+BENCHMARK(typed_iteration)->Range(64, 64 << 10);
+BENCHMARK(raw_iteration)->Range(64, 64 << 10);
+BENCHMARK(typed_advance)->Range(1 << 10, 1 << 20);
+BENCHMARK(raw_advance)->Range(1 << 10, 1 << 20);
+BENCHMARK(typed_str_len)->Range(8, 8 << 10);
+BENCHMARK(raw_str_len)->Range(8, 8 << 10);
+BENCHMARK(typed_str_cpy)->Range(8, 8 << 10);
+BENCHMARK(raw_str_cpy)->Range(8, 8 << 10);
+BENCHMARK(typed_make_safe_array)->Range(16, 16 << 10);
+BENCHMARK(raw_make_safe_array)->Range(16, 16 << 10);
+
+int main(int argc, char** argv)
+{
+	register_conversions(units());
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+	{
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
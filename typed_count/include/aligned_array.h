@@ -0,0 +1,306 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Deleter of unique_aligned_safe_array.
+template <typename T>
+struct aligned_array_delete
+{
+	std::size_t alignment = alignof(T);	//!< alignment the array was allocated with.
+
+	void operator()(safe_array<T> array) const noexcept
+	{
+		std::destroy_n(array.data(), array.count().to_size());
+		::operator delete(array.data(), std::align_val_t(alignment));
+	}
+};
+
+//! owning safe array allocated by make_aligned_safe_array().
+template <typename T>
+using unique_aligned_safe_array = unique_safe_array<T, aligned_array_delete<T>>;
+
+//! Huge pages requested by make_huge_page_safe_array().
+enum class huge_page_mode
+{
+	transparent,	//!< 2MB aligned memory advised to be backed by transparent huge pages.
+	explicit_2mb,	//!< explicit 2MB huge pages. Falls back to transparent.
+	explicit_1gb,	//!< explicit 1GB huge pages. Falls back to explicit_2mb.
+};
+
+//! Pages which actually back an array allocated by make_huge_page_safe_array().
+enum class page_backing
+{
+	regular,		//!< regular pages only.
+	transparent,	//!< transparent huge pages are requested but the kernel may not provide them.
+	huge_2mb,		//!< explicit 2MB huge pages.
+	huge_1gb,		//!< explicit 1GB huge pages.
+};
+
+//! Deleter of unique_huge_safe_array.
+template <typename T>
+struct mapped_array_delete
+{
+	byte_count mapped;								//!< mapped size rounded up to the page size.
+	page_backing backing = page_backing::regular;	//!< pages backing the array.
+
+	void operator()(safe_array<T> array) const noexcept;
+};
+
+//! owning safe array allocated by make_huge_page_safe_array().
+template <typename T>
+using unique_huge_safe_array = unique_safe_array<T, mapped_array_delete<T>>;
+
+namespace detail
+{
+
+//! byte count of count elements. Throws std::bad_alloc if it doesn't fit in size_t.
+template <typename T, typename Rep, typename Policy>
+std::size_t checked_byte_count(count_of<T, Rep, Policy> count)
+{
+	if (count.to_size() > SIZE_MAX / sizeof(T))
+	{
+		throw std::bad_alloc();
+	}
+	return count.to_size() * sizeof(T);
+}
+
+//! rounds bytes up to a multiple of a power of two unit. Throws std::bad_alloc on overflow.
+inline std::size_t round_up_bytes(std::size_t bytes, std::size_t unit)
+{
+	if (bytes > SIZE_MAX - (unit - 1))
+	{
+		throw std::bad_alloc();
+	}
+	return (bytes + unit - 1) & ~(unit - 1);
+}
+
+inline std::size_t round_up_to_power_of_two(std::size_t value) noexcept
+{
+	std::size_t result = 1;
+	while (result < value)
+	{
+		result <<= 1;
+	}
+	return result;
+}
+
+//! releases memory mapped by map_huge_pages().
+inline void unmap_pages(void* p, std::size_t bytes) noexcept
+{
+#if defined(_WIN32)
+	(void)bytes;
+	::VirtualFree(p, 0, MEM_RELEASE);
+#else
+	::munmap(p, bytes);
+#endif
+}
+
+//! maps bytes which must be a multiple of the page size of backing. Returns nullptr on failure.
+inline void* map_pages(std::size_t bytes, page_backing backing) noexcept
+{
+#if defined(_WIN32)
+	DWORD type = MEM_RESERVE | MEM_COMMIT;
+	if (backing == page_backing::huge_2mb || backing == page_backing::huge_1gb)
+	{
+		// Requires SeLockMemoryPrivilege. Windows has no separate 1GB request.
+		const SIZE_T large_page = ::GetLargePageMinimum();
+		if (large_page == 0 || bytes % large_page != 0)
+		{
+			return nullptr;
+		}
+		type |= MEM_LARGE_PAGES;
+	}
+	return ::VirtualAlloc(nullptr, bytes, type, PAGE_READWRITE);
+#else
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_HUGETLB)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+	if (backing == page_backing::huge_2mb)
+	{
+		flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+	}
+	else if (backing == page_backing::huge_1gb)
+	{
+		flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+	}
+#else
+	if (backing == page_backing::huge_2mb || backing == page_backing::huge_1gb)
+	{
+		return nullptr;
+	}
+#endif
+	void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+	return p == MAP_FAILED ? nullptr : p;
+#endif
+}
+
+//! maps bytes aligned to alignment and advises transparent huge pages. Returns nullptr on failure.
+inline void* map_transparent_huge_pages(std::size_t bytes, std::size_t alignment) noexcept
+{
+#if defined(_WIN32)
+	// Windows has no transparent huge pages.
+	(void)bytes;
+	(void)alignment;
+	return nullptr;
+#else
+	// Over-maps and trims both ends so that the mapping is aligned to a huge page.
+	if (bytes == 0 || bytes > SIZE_MAX - alignment)
+	{
+		return nullptr;
+	}
+	auto p = static_cast<unsigned char*>(map_pages(bytes + alignment, page_backing::regular));
+	if (!p)
+	{
+		return nullptr;
+	}
+	const auto addr = reinterpret_cast<std::uintptr_t>(p);
+	const std::size_t head = ((addr + alignment - 1) & ~std::uintptr_t(alignment - 1)) - addr;
+	if (head)
+	{
+		::munmap(p, head);
+	}
+	::munmap(p + head + bytes, alignment - head);
+#if defined(MADV_HUGEPAGE)
+	::madvise(p + head, bytes, MADV_HUGEPAGE);
+#endif
+	return p + head;
+#endif
+}
+
+}
+
+template <typename T>
+void mapped_array_delete<T>::operator()(safe_array<T> array) const noexcept
+{
+	std::destroy_n(array.data(), array.count().to_size());
+	detail::unmap_pages(array.data(), mapped.to_size());
+}
+
+//! allocates a default-initialized owning safe array aligned to alignment.
+//!
+//! Useful for cache-line aligned buffers for SIMD or page aligned buffers for O_DIRECT.
+//! alignment is raised to alignof(T) or the next power of two if needed.
+//! Throws std::bad_alloc if the memory can't be allocated.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! auto pBlock = make_aligned_safe_array(4096_bt, 4096_bt);	// for O_DIRECT
+//! @endcode
+template <typename T, typename Rep, typename Policy>
+unique_aligned_safe_array<T> make_aligned_safe_array(count_of<T, Rep, Policy> count, byte_count alignment)
+{
+	const std::size_t bytes = detail::checked_byte_count(count);
+	std::size_t align = detail::round_up_to_power_of_two(alignment.to_size());
+	if (align < alignof(T))
+	{
+		align = alignof(T);
+	}
+
+	auto p = static_cast<T*>(::operator new(bytes, std::align_val_t(align)));
+	try
+	{
+		std::uninitialized_default_construct_n(p, count.to_size());
+	}
+	catch (...)
+	{
+		::operator delete(p, std::align_val_t(align));
+		throw;
+	}
+	return unique_aligned_safe_array<T>({ p, count }, aligned_array_delete<T>{ align });
+}
+
+//! allocates a default-initialized owning safe array backed by huge pages.
+//!
+//! The mapping is rounded up to the huge page size, 2MB or 1GB, so that big tables don't
+//! suffer from TLB misses. If the requested huge pages aren't available, it falls back
+//! to smaller huge pages, then to transparent huge pages, and finally to regular pages.
+//! The pages actually obtained are in get_deleter().backing.
+//! A count of 0 returns an empty array without mapping anything.
+//! Throws std::bad_alloc if the memory can't be mapped at all.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! auto pTable = make_huge_page_safe_array(count_of<std::uint64_t>(1 << 28), huge_page_mode::explicit_1gb);
+//! bool huge = pTable.get_deleter().backing != page_backing::regular;
+//! @endcode
+template <typename T, typename Rep, typename Policy>
+unique_huge_safe_array<T> make_huge_page_safe_array(count_of<T, Rep, Policy> count, huge_page_mode mode = huge_page_mode::transparent)
+{
+	static_assert(alignof(T) <= 4096);
+
+	if (count == count_of<T>(0))
+	{
+		return unique_huge_safe_array<T>();
+	}
+
+	const std::size_t bytes = detail::checked_byte_count(count);
+	const std::size_t huge_2mb = mb_count(2).to_byte_count();
+	const std::size_t huge_1gb = gb_count(1).to_byte_count();
+
+	void* p = nullptr;
+	std::size_t mapped = 0;
+	page_backing backing = page_backing::regular;
+	if (mode == huge_page_mode::explicit_1gb)
+	{
+		mapped = detail::round_up_bytes(bytes, huge_1gb);
+		p = detail::map_pages(mapped, backing = page_backing::huge_1gb);
+	}
+	if (!p && mode != huge_page_mode::transparent)
+	{
+		mapped = detail::round_up_bytes(bytes, huge_2mb);
+		p = detail::map_pages(mapped, backing = page_backing::huge_2mb);
+	}
+	if (!p)
+	{
+		mapped = detail::round_up_bytes(bytes, huge_2mb);
+		p = detail::map_transparent_huge_pages(mapped, huge_2mb);
+		backing = page_backing::transparent;
+	}
+	if (!p)
+	{
+		mapped = detail::round_up_bytes(bytes, kb_count(64).to_byte_count());
+		p = detail::map_pages(mapped, backing = page_backing::regular);
+	}
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+
+	auto elems = static_cast<T*>(p);
+	try
+	{
+		std::uninitialized_default_construct_n(elems, count.to_size());
+	}
+	catch (...)
+	{
+		detail::unmap_pages(p, mapped);
+		throw;
+	}
+	return unique_huge_safe_array<T>({ elems, count }, mapped_array_delete<T>{ byte_count(mapped), backing });
+}
+
+//! @}
+
+}
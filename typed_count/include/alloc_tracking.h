@@ -0,0 +1,361 @@
+﻿#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if TYPED_COUNT_ALLOC_TRACKING
+#include <atomic>
+#include <mutex>
+#endif
+
+#include "typed_count_core.h"
+
+//! @addtogroup utilities
+//! @{
+
+//! TYPED_COUNT_ALLOC_TRACKING enables allocation accounting of tagged allocations when 1.
+//!
+//! The default 0 compiles the accounting out. Tagged allocations are then plain allocations
+//! and snapshots are empty.
+#ifndef TYPED_COUNT_ALLOC_TRACKING
+#define TYPED_COUNT_ALLOC_TRACKING 0
+#endif
+
+//! declares an allocation tag named like the struct.
+#define TYPED_COUNT_ALLOC_TAG(tag_name)											\
+	struct tag_name : ::typed_count::alloc_tag										\
+	{																				\
+		static constexpr const char* name = #tag_name;								\
+	}
+
+//! @}
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Base of allocation tags
+//!
+//! A tag is a type which names the call sites accounted together, like tag::parser.
+//! It derives from alloc_tag and has a static name. TYPED_COUNT_ALLOC_TAG() declares one.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! namespace tag { TYPED_COUNT_ALLOC_TAG(parser); }
+//! auto tokens = make_unique_safe_array<tag::parser>(count_of<token>(n));
+//! for (const auto& stats : alloc_snapshot()) { log(stats.name, stats.live_bytes); }
+//! @endcode
+struct alloc_tag
+{};
+
+template <typename Tag>
+constexpr bool is_alloc_tag_v = std::is_base_of_v<alloc_tag, Tag>;
+
+//! Accounting of allocations of a tag.
+struct alloc_tag_stats
+{
+	const char* name;
+	std::size_t allocations;		//!< number of allocations.
+	byte_count bytes;				//!< bytes of all allocations.
+	byte_count live_bytes;			//!< bytes allocated and not freed by tracking deleters.
+	byte_count peak_live_bytes;		//!< high-water mark of live_bytes.
+};
+
+namespace detail
+{
+
+#if TYPED_COUNT_ALLOC_TRACKING
+
+//! maximum number of tags. Further tags are accounted to the last one.
+constexpr std::size_t max_alloc_tags = 64;
+
+//! a thread publishes its live bytes to the high-water mark after this much change.
+constexpr std::int64_t alloc_publish_threshold = 64 * 1024;
+
+//! Registry of tags and of per-thread counters
+//!
+//! Each thread counts in its own block with relaxed single-writer stores, so an allocation
+//! doesn't touch a shared cache line. snapshot() sums the blocks of live threads and the
+//! totals of finished threads. Live bytes are also published to a shared counter every
+//! alloc_publish_threshold bytes. An allocation compares the shared live bytes plus its own
+//! unpublished ones with the high-water mark, which is exact on one thread and misses at most
+//! alloc_publish_threshold bytes for each other thread.
+class alloc_registry
+{
+public:
+	struct slot
+	{
+		std::atomic<std::size_t> allocations{ 0 };
+		std::atomic<std::size_t> bytes{ 0 };
+		std::atomic<std::size_t> freed{ 0 };
+	};
+
+	struct thread_block
+	{
+		slot slots[max_alloc_tags];
+		std::int64_t unpublished[max_alloc_tags] = {};
+		thread_block* next = nullptr;
+
+		thread_block()
+		{
+			alloc_registry::instance().attach(this);
+		}
+
+		~thread_block()
+		{
+			alloc_registry::instance().detach(this);
+		}
+	};
+
+private:
+	std::mutex mutex_;
+	thread_block* threads_ = nullptr;
+	slot retired_[max_alloc_tags];
+	std::atomic<std::int64_t> live_[max_alloc_tags] = {};
+	std::atomic<std::int64_t> peak_[max_alloc_tags] = {};
+	const char* names_[max_alloc_tags] = {};
+	std::size_t tags_ = 0;
+
+public:
+	static alloc_registry& instance()
+	{
+		static alloc_registry registry;
+		return registry;
+	}
+
+	//! returns the counters of the calling thread.
+	static thread_block& current()
+	{
+		thread_local thread_block block;
+		return block;
+	}
+
+	std::size_t add_tag(const char* name)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		assert(tags_ < max_alloc_tags);
+		if (tags_ == max_alloc_tags)
+		{
+			return max_alloc_tags - 1;
+		}
+		names_[tags_] = name;
+		return tags_++;
+	}
+
+	void record(std::size_t tag, std::size_t bytes, bool allocated)
+	{
+		thread_block& block = current();
+		slot& s = block.slots[tag];
+		std::int64_t& unpublished = block.unpublished[tag];
+		if (allocated)
+		{
+			s.allocations.store(s.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			s.bytes.store(s.bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+			unpublished += static_cast<std::int64_t>(bytes);
+			// Shared counters are only read unless this is a new high-water mark.
+			const std::int64_t live = live_[tag].load(std::memory_order_relaxed) + unpublished;
+			if (live > peak_[tag].load(std::memory_order_relaxed))
+			{
+				raise_peak(tag, live);
+			}
+		}
+		else
+		{
+			s.freed.store(s.freed.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+			unpublished -= static_cast<std::int64_t>(bytes);
+		}
+		if (unpublished >= alloc_publish_threshold || unpublished <= -alloc_publish_threshold)
+		{
+			publish(tag, unpublished);
+			unpublished = 0;
+		}
+	}
+
+	std::vector<alloc_tag_stats> snapshot()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<alloc_tag_stats> result;
+		result.reserve(tags_);
+		for (std::size_t tag = 0; tag < tags_; ++tag)
+		{
+			std::size_t allocations = retired_[tag].allocations.load(std::memory_order_relaxed);
+			std::size_t bytes = retired_[tag].bytes.load(std::memory_order_relaxed);
+			std::size_t freed = retired_[tag].freed.load(std::memory_order_relaxed);
+			for (thread_block* block = threads_; block; block = block->next)
+			{
+				allocations += block->slots[tag].allocations.load(std::memory_order_relaxed);
+				bytes += block->slots[tag].bytes.load(std::memory_order_relaxed);
+				freed += block->slots[tag].freed.load(std::memory_order_relaxed);
+			}
+			// Frees may be counted on another thread before the allocation is visible.
+			const std::size_t live = bytes > freed ? bytes - freed : 0;
+			const std::size_t peak = static_cast<std::size_t>(peak_[tag].load(std::memory_order_relaxed));
+			result.push_back({ names_[tag], allocations, byte_count(bytes), byte_count(live), byte_count(peak > live ? peak : live) });
+		}
+		return result;
+	}
+
+private:
+	void publish(std::size_t tag, std::int64_t delta) noexcept
+	{
+		raise_peak(tag, live_[tag].fetch_add(delta, std::memory_order_relaxed) + delta);
+	}
+
+	void raise_peak(std::size_t tag, std::int64_t live) noexcept
+	{
+		std::int64_t peak = peak_[tag].load(std::memory_order_relaxed);
+		while (live > peak && !peak_[tag].compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		{}
+	}
+
+	void attach(thread_block* block)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		block->next = threads_;
+		threads_ = block;
+	}
+
+	//! moves the counters of a finishing thread to the retired totals.
+	void detach(thread_block* block)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (std::size_t tag = 0; tag < max_alloc_tags; ++tag)
+		{
+			retired_[tag].allocations.fetch_add(block->slots[tag].allocations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			retired_[tag].bytes.fetch_add(block->slots[tag].bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			retired_[tag].freed.fetch_add(block->slots[tag].freed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			if (block->unpublished[tag])
+			{
+				publish(tag, block->unpublished[tag]);
+			}
+		}
+		thread_block** link = &threads_;
+		while (*link != block)
+		{
+			link = &(*link)->next;
+		}
+		*link = block->next;
+	}
+};
+
+template <typename Tag>
+std::size_t alloc_tag_index()
+{
+	static const std::size_t index = alloc_registry::instance().add_tag(Tag::name);
+	return index;
+}
+
+#endif
+
+//! accounts an allocation of bytes to Tag. Does nothing unless TYPED_COUNT_ALLOC_TRACKING.
+template <typename Tag>
+inline void record_alloc(std::size_t bytes) noexcept
+{
+#if TYPED_COUNT_ALLOC_TRACKING
+	try
+	{
+		alloc_registry::instance().record(alloc_tag_index<Tag>(), bytes, true);
+	}
+	catch (...)
+	{
+		// A failed registration only loses the accounting.
+	}
+#else
+	(void)bytes;
+#endif
+}
+
+//! accounts a free of bytes to Tag. Does nothing unless TYPED_COUNT_ALLOC_TRACKING.
+template <typename Tag>
+inline void record_free(std::size_t bytes) noexcept
+{
+#if TYPED_COUNT_ALLOC_TRACKING
+	try
+	{
+		alloc_registry::instance().record(alloc_tag_index<Tag>(), bytes, false);
+	}
+	catch (...)
+	{
+		// A failed registration only loses the accounting.
+	}
+#else
+	(void)bytes;
+#endif
+}
+
+}
+
+//! returns the accounting of all tags used so far.
+//!
+//! Returns an empty vector unless TYPED_COUNT_ALLOC_TRACKING.
+inline std::vector<alloc_tag_stats> alloc_snapshot()
+{
+#if TYPED_COUNT_ALLOC_TRACKING
+	return detail::alloc_registry::instance().snapshot();
+#else
+	return {};
+#endif
+}
+
+//! Deleter of unique_safe_array which accounts the free to Tag and deletes by delete[].
+template <typename T, typename Tag>
+struct tagged_array_delete
+{
+	void operator()(safe_array<T> array) const noexcept
+	{
+		detail::record_free<Tag>(array.count().to_byte_count());
+		delete[] array.data();
+	}
+};
+
+//! allocates an array accounted to Tag like make_array().
+template <typename Tag, typename T, typename Rep, typename Policy, std::enable_if_t<is_alloc_tag_v<Tag>, int> = 0>
+T* make_array(count_of<T, Rep, Policy> count)
+{
+	T* p = new T[count.to_size()];
+	detail::record_alloc<Tag>(count.to_byte_count());
+	return p;
+}
+
+//! allocates a safe array accounted to Tag like make_safe_array().
+//!
+//! Deleting it by delete[] isn't accounted, so it stays in live_bytes. Use delete_safe_array().
+template <typename Tag, typename T, typename Rep, typename Policy, std::enable_if_t<is_alloc_tag_v<Tag>, int> = 0>
+safe_array<T> make_safe_array(count_of<T, Rep, Policy> count)
+{
+	return { make_array<Tag>(count), count };
+}
+
+//! deletes an array allocated by make_safe_array<Tag>() and accounts the free.
+template <typename Tag, typename T, std::enable_if_t<is_alloc_tag_v<Tag>, int> = 0>
+void delete_safe_array(safe_array<T> array) noexcept
+{
+	tagged_array_delete<T, Tag>()(array);
+}
+
+//! allocates a value-initialized owning safe array accounted to Tag, including its free.
+template <typename Tag, typename T, typename Rep, typename Policy, std::enable_if_t<is_alloc_tag_v<Tag>, int> = 0>
+unique_safe_array<T, tagged_array_delete<T, Tag>> make_unique_safe_array(count_of<T, Rep, Policy> count)
+{
+	unique_safe_array<T, tagged_array_delete<T, Tag>> array({ new T[count.to_size()](), count });
+	detail::record_alloc<Tag>(count.to_byte_count());
+	return array;
+}
+
+//! allocates a default-initialized owning safe array accounted to Tag, including its free.
+template <typename Tag, typename T, typename Rep, typename Policy, std::enable_if_t<is_alloc_tag_v<Tag>, int> = 0>
+unique_safe_array<T, tagged_array_delete<T, Tag>> make_safe_array_for_overwrite(count_of<T, Rep, Policy> count)
+{
+	unique_safe_array<T, tagged_array_delete<T, Tag>> array({ new T[count.to_size()], count });
+	detail::record_alloc<Tag>(count.to_byte_count());
+	return array;
+}
+
+//! @}
+
+}
@@ -0,0 +1,476 @@
+﻿#pragma once
+
+#if defined(__linux__) && __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <cassert>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "typed_count_core.h"
+#include "io_uring_queue.h"
+
+namespace typed_count
+{
+
+class io_loop;
+
+//! @addtogroup utilities
+//! @{
+
+//! offset of async_read() and async_write() which reads or writes at the current position
+//! of the fd like read() and write(). Sockets and pipes have no other position.
+constexpr std::uint64_t current_position = ~std::uint64_t(0);
+
+//! Coroutine run by an io_loop
+//!
+//! A function returning io_task is a coroutine which starts when it is spawned on an
+//! io_loop or awaited by another io_task. It may co_await async_read(), async_write() and
+//! other io_tasks, which resume it when they complete. An exception thrown out of an
+//! awaited io_task is rethrown by co_await. One escaping a spawned io_task is rethrown by
+//! io_loop::run().
+class io_task
+{
+public:
+	struct promise_type;
+
+private:
+	using handle_t = std::coroutine_handle<promise_type>;
+
+	//! resumes the awaiting coroutine, or frees a spawned task and notifies its loop.
+	struct final_awaiter
+	{
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(handle_t h) noexcept;
+
+		void await_resume() const noexcept
+		{}
+	};
+
+	handle_t handle_;
+
+	explicit io_task(handle_t handle) noexcept
+		: handle_(handle)
+	{}
+
+	friend class io_loop;
+
+public:
+	struct promise_type
+	{
+		std::coroutine_handle<> continuation;	//!< coroutine awaiting this task.
+		io_loop* loop = nullptr;				//!< loop which the task is spawned on.
+		std::exception_ptr error;
+
+		io_task get_return_object() noexcept
+		{
+			return io_task(handle_t::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() const noexcept
+		{
+			return {};
+		}
+
+		final_awaiter final_suspend() const noexcept
+		{
+			return {};
+		}
+
+		void return_void() const noexcept
+		{}
+
+		void unhandled_exception() noexcept
+		{
+			error = std::current_exception();
+		}
+	};
+
+	io_task(io_task&& other) noexcept
+		: handle_(std::exchange(other.handle_, {}))
+	{}
+
+	io_task(const io_task&) = delete;
+	io_task& operator =(const io_task&) = delete;
+
+	~io_task()
+	{
+		if (handle_)
+		{
+			handle_.destroy();
+		}
+	}
+
+	//! runs the task until it completes and rethrows its exception.
+	auto operator co_await() && noexcept
+	{
+		struct awaiter
+		{
+			handle_t h;
+
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				h.promise().continuation = awaiting;
+				return h;
+			}
+
+			void await_resume() const
+			{
+				if (h.promise().error)
+				{
+					std::rethrow_exception(h.promise().error);
+				}
+			}
+		};
+		return awaiter{ handle_ };
+	}
+};
+
+namespace detail
+{
+
+//! A read or write awaited by a task. user_data of its io_uring entry points to it.
+struct io_request
+{
+	// Linux reads and writes at most this much at once anyway.
+	static constexpr std::size_t max_bytes = 0x7FFFF000;
+
+	std::coroutine_handle<> waiter;
+	unsigned char opcode;	//!< IORING_OP_READ or IORING_OP_WRITE.
+	int fd;
+	void* p;
+	std::size_t bytes;
+	std::uint64_t offset;
+	int result = 0;			//!< bytes transferred or a negative errno.
+
+	//! reads or writes synchronously and sets result.
+	void transfer() noexcept
+	{
+		ssize_t r;
+		do
+		{
+			if (opcode == IORING_OP_READ)
+			{
+				r = offset == current_position ? ::read(fd, p, bytes) : ::pread(fd, p, bytes, static_cast<off_t>(offset));
+			}
+			else
+			{
+				r = offset == current_position ? ::write(fd, p, bytes) : ::pwrite(fd, p, bytes, static_cast<off_t>(offset));
+			}
+		} while (r < 0 && errno == EINTR);
+		result = r < 0 ? -errno : static_cast<int>(r);
+	}
+};
+
+template <typename Byte, unsigned char Opcode>
+class io_awaitable;
+
+}
+
+//! Event loop running io_tasks on io_uring
+//!
+//! Reads and writes awaited by the tasks are queued to io_uring and submitted together when
+//! all runnable tasks are suspended, so thousands of connections are served by one thread
+//! without a thread or a callback chain per connection. Without io_uring, like in some
+//! containers, the loop falls back to poll() and reads or writes an fd once it is ready.
+//! Reads and writes at an offset are then done synchronously as files are always ready.
+//! Sockets and pipes should be non-blocking so that a large write doesn't block the loop.
+//! Tasks must await only I/O of their loop and other io_tasks, and must complete before the
+//! loop is destroyed. io_loop is not thread-safe. Run one on each thread instead.
+//! Windows is not supported yet.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! io_task echo(io_loop& loop, int fd)
+//! {
+//!     fixed_size_array<std::byte, 4096> buf;
+//!     for (;;)
+//!     {
+//!         const byte_count n = co_await async_read(loop, fd, buf);
+//!         if (n == 0_bt)
+//!         {
+//!             co_return;
+//!         }
+//!         safe_array<const std::byte> pending{ buf.elems, n };
+//!         while (pending)
+//!         {
+//!             pending += co_await async_write(loop, fd, pending);		// handles partial writes
+//!         }
+//!     }
+//! }
+//!
+//! io_loop loop;
+//! for (int fd : connections) { loop.spawn(echo(loop, fd)); }
+//! loop.run();
+//! @endcode
+class io_loop
+{
+	detail::io_uring_queue ring_;
+	std::vector<detail::io_request*> polled_;	//!< requests waiting for poll() without io_uring.
+	std::size_t tasks_ = 0;
+	std::exception_ptr error_;
+
+public:
+	//! ctor. Up to entries I/O are submitted at once and more wait for the next submission.
+	explicit io_loop(unsigned entries = 256) noexcept
+		: ring_(entries)
+	{}
+
+	io_loop(const io_loop&) = delete;
+	io_loop& operator =(const io_loop&) = delete;
+
+	~io_loop()
+	{
+		assert(tasks_ == 0);
+	}
+
+	//! true if I/O runs on io_uring. Otherwise the loop polls.
+	bool uses_io_uring() const noexcept
+	{
+		return ring_.valid();
+	}
+
+	//! returns the number of spawned tasks which haven't completed.
+	std::size_t active_tasks() const noexcept
+	{
+		return tasks_;
+	}
+
+	//! starts a task which runs until its first I/O. run() runs it to completion.
+	void spawn(io_task task) noexcept
+	{
+		const io_task::handle_t h = std::exchange(task.handle_, {});
+		h.promise().loop = this;
+		++tasks_;
+		h.resume();
+	}
+
+	//! runs spawned tasks until all of them complete.
+	//!
+	//! Rethrows the first exception which escaped a task. The other tasks keep their state,
+	//! so run() can be called again. Throws std::system_error if io_uring or poll() fails.
+	void run()
+	{
+		while (tasks_ && !error_)
+		{
+			if (uses_io_uring())
+			{
+				io_uring_cqe cqe;
+				if (const int r = ring_.wait(cqe))
+				{
+					throw std::system_error(-r, std::generic_category(), "io_uring_enter");
+				}
+				auto request = reinterpret_cast<detail::io_request*>(cqe.user_data);
+				request->result = cqe.res;
+				request->waiter.resume();
+			}
+			else
+			{
+				poll_once();
+			}
+		}
+		if (error_)
+		{
+			std::rethrow_exception(std::exchange(error_, nullptr));
+		}
+	}
+
+private:
+	friend struct io_task::final_awaiter;
+
+	template <typename Byte, unsigned char Opcode>
+	friend class detail::io_awaitable;
+
+	//! queues a request which resumes its waiter when it completes.
+	//!
+	//! Throws std::system_error if io_uring fails or std::bad_alloc.
+	void submit(detail::io_request& request)
+	{
+		if (!uses_io_uring())
+		{
+			polled_.push_back(&request);
+			return;
+		}
+
+		io_uring_sqe* sqe = ring_.get_sqe();
+		if (!sqe)
+		{
+			// The kernel may take fewer entries than queued when it can't post more completions.
+			const int r = ring_.submit();
+			if (r < 0)
+			{
+				throw std::system_error(-r, std::generic_category(), "io_uring_enter");
+			}
+			sqe = ring_.get_sqe();
+			if (!sqe)
+			{
+				throw std::system_error(EBUSY, std::generic_category(), "io_uring_enter");
+			}
+		}
+		sqe->opcode = request.opcode;
+		sqe->fd = request.fd;
+		sqe->addr = reinterpret_cast<std::uint64_t>(request.p);
+		sqe->len = static_cast<unsigned>(request.bytes);
+		sqe->off = request.offset;
+		sqe->user_data = reinterpret_cast<std::uint64_t>(&request);
+	}
+
+	//! waits until polled fds are ready and completes their requests.
+	void poll_once()
+	{
+		assert(!polled_.empty());
+		std::vector<pollfd> fds(polled_.size());
+		for (std::size_t i = 0; i < fds.size(); ++i)
+		{
+			fds[i] = { polled_[i]->fd, static_cast<short>(polled_[i]->opcode == IORING_OP_READ ? POLLIN : POLLOUT), 0 };
+		}
+		if (::poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				return;
+			}
+			throw std::system_error(errno, std::generic_category(), "poll");
+		}
+
+		// Resumed tasks may queue new requests, so completed ones are taken out first.
+		std::vector<detail::io_request*> completed;
+		std::size_t kept = 0;
+		for (std::size_t i = 0; i < fds.size(); ++i)
+		{
+			detail::io_request* request = polled_[i];
+			if (fds[i].revents)
+			{
+				request->transfer();
+				// A non-blocking fd may still not be ready.
+				if (request->result != -EAGAIN && request->result != -EWOULDBLOCK)
+				{
+					completed.push_back(request);
+					continue;
+				}
+			}
+			polled_[kept++] = request;
+		}
+		polled_.resize(kept);
+		for (detail::io_request* request : completed)
+		{
+			request->waiter.resume();
+		}
+	}
+
+	void task_completed(std::exception_ptr error) noexcept
+	{
+		--tasks_;
+		if (error && !error_)
+		{
+			error_ = std::move(error);
+		}
+	}
+};
+
+inline std::coroutine_handle<> io_task::final_awaiter::await_suspend(handle_t h) noexcept
+{
+	promise_type& promise = h.promise();
+	if (promise.continuation)
+	{
+		return promise.continuation;
+	}
+	io_loop* loop = promise.loop;
+	std::exception_ptr error = std::move(promise.error);
+	h.destroy();
+	loop->task_completed(std::move(error));
+	return std::noop_coroutine();
+}
+
+namespace detail
+{
+
+//! Awaitable read or write of a safe_array of bytes
+template <typename Byte, unsigned char Opcode>
+class io_awaitable
+{
+	io_loop& loop_;
+	io_request request_;
+
+public:
+	io_awaitable(io_loop& loop, int fd, safe_array<Byte> buffer, std::uint64_t offset) noexcept
+		: loop_(loop)
+	{
+		request_.opcode = Opcode;
+		request_.fd = fd;
+		request_.p = const_cast<std::byte*>(buffer.data());
+		request_.bytes = buffer.count().to_size() < io_request::max_bytes ? buffer.count().to_size() : io_request::max_bytes;
+		request_.offset = offset;
+	}
+
+	//! reads or writes at an offset right away without io_uring.
+	bool await_ready() noexcept
+	{
+		// poll() ignores negative fds, so their error is returned right away too.
+		if (loop_.uses_io_uring() || (request_.offset == current_position && request_.fd >= 0))
+		{
+			return false;
+		}
+		request_.transfer();
+		return true;
+	}
+
+	void await_suspend(std::coroutine_handle<> waiter)
+	{
+		request_.waiter = waiter;
+		loop_.submit(request_);
+	}
+
+	//! returns bytes transferred. Throws std::system_error on an I/O error.
+	byte_count await_resume() const
+	{
+		if (request_.result < 0)
+		{
+			throw std::system_error(-request_.result, std::generic_category(), Opcode == IORING_OP_READ ? "async_read" : "async_write");
+		}
+		return byte_count(static_cast<std::size_t>(request_.result));
+	}
+};
+
+}
+
+//! reads up to dst.count() bytes from fd. co_await returns bytes read, 0_bt at the end.
+//!
+//! Partial reads are normal for sockets and pipes. Advance dst by the result to read the rest.
+//! dst must stay valid until the read completes.
+inline detail::io_awaitable<std::byte, IORING_OP_READ> async_read(io_loop& loop, int fd, safe_array<std::byte> dst, std::uint64_t offset = current_position) noexcept
+{
+	return { loop, fd, dst, offset };
+}
+
+//! writes up to src.count() bytes to fd. co_await returns bytes written.
+//!
+//! Writes to sockets and pipes may be partial, so write the rest in a `while (src)` loop
+//! advancing src by the result. src must stay valid until the write completes.
+inline detail::io_awaitable<const std::byte, IORING_OP_WRITE> async_write(io_loop& loop, int fd, safe_array<const std::byte> src, std::uint64_t offset = current_position) noexcept
+{
+	return { loop, fd, src, offset };
+}
+
+//! @}
+
+}
+
+#endif
@@ -0,0 +1,254 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Atomic count of T
+//!
+//! std::atomic<size_t> that keeps the unit, so that counters shared by threads take and
+//! return count_of<T>. Memory orders are like std::atomic and default to seq_cst. Statistics
+//! usually need only std::memory_order_relaxed.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! atomic_count_of<Page> dirtyPages;
+//! dirtyPages.fetch_add(page_count(1), std::memory_order_relaxed);
+//! kb_count dirtyKb = dirtyPages.to_count_of<Kb>();
+//! @endcode
+template <typename T>
+class atomic_count_of
+{
+	std::atomic<std::size_t> value_;
+
+public:
+	constexpr atomic_count_of() noexcept
+		: value_(0)
+	{}
+
+	constexpr explicit atomic_count_of(count_of<T> count) noexcept
+		: value_(count.to_size())
+	{}
+
+	atomic_count_of(const atomic_count_of&) = delete;
+	atomic_count_of& operator =(const atomic_count_of&) = delete;
+
+	count_of<T> load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		return count_of<T>(value_.load(order));
+	}
+
+	void store(count_of<T> count, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		value_.store(count.to_size(), order);
+	}
+
+	count_of<T> exchange(count_of<T> count, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		return count_of<T>(value_.exchange(count.to_size(), order));
+	}
+
+	bool compare_exchange_weak(count_of<T>& expected, count_of<T> desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		std::size_t raw = expected.to_size();
+		const bool exchanged = value_.compare_exchange_weak(raw, desired.to_size(), order);
+		expected = count_of<T>(raw);
+		return exchanged;
+	}
+
+	bool compare_exchange_strong(count_of<T>& expected, count_of<T> desired, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		std::size_t raw = expected.to_size();
+		const bool exchanged = value_.compare_exchange_strong(raw, desired.to_size(), order);
+		expected = count_of<T>(raw);
+		return exchanged;
+	}
+
+	//! adds count and returns the previous value.
+	count_of<T> fetch_add(count_of<T> count, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		return count_of<T>(value_.fetch_add(count.to_size(), order));
+	}
+
+	//! subtracts count and returns the previous value.
+	count_of<T> fetch_sub(count_of<T> count, std::memory_order order = std::memory_order_seq_cst) noexcept
+	{
+		return count_of<T>(value_.fetch_sub(count.to_size(), order));
+	}
+
+	//! supports += operator. Returns the new value.
+	count_of<T> operator +=(count_of<T> count) noexcept
+	{
+		return fetch_add(count) + count;
+	}
+
+	//! supports -= operator. Returns the new value.
+	count_of<T> operator -=(count_of<T> count) noexcept
+	{
+		return fetch_sub(count) - count;
+	}
+
+	//! loads the value and converts it to count of U.
+	template <typename U>
+	count_of<U> to_count_of(std::memory_order order = std::memory_order_seq_cst) const noexcept
+	{
+		return load(order).template to_count_of<U>();
+	}
+};
+
+static_assert(sizeof(atomic_count_of<std::byte>) == sizeof(std::size_t));
+
+namespace detail
+{
+
+//! size of a cache line. Slots padded to this don't share cache lines.
+constexpr std::size_t cache_line_size = 64;
+
+//! returns the CPU the calling thread runs on or a stable per-thread number if it can't be queried.
+inline std::size_t current_cpu() noexcept
+{
+#if defined(_WIN32)
+	return ::GetCurrentProcessorNumber();
+#elif defined(__linux__)
+	const int cpu = ::sched_getcpu();
+	if (cpu >= 0)
+	{
+		return static_cast<std::size_t>(cpu);
+	}
+#endif
+	static std::atomic<std::size_t> next_thread{ 0 };
+	static thread_local const std::size_t thread_number = next_thread.fetch_add(1, std::memory_order_relaxed);
+	return thread_number;
+}
+
+}
+
+//! Write-mostly count of T sharded in per-CPU slots
+//!
+//! A single atomic counter updated by many threads makes its cache line bounce between cores.
+//! sharded_count_of<T> adds to a cache line padded slot picked by the current CPU, with
+//! relaxed atomics, and sums the slots on load(). load() may miss concurrent updates
+//! but is exact once the writers are done.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! sharded_count_of<std::byte> allocated;
+//! allocated.add(byte_count(size));		// from any thread
+//! mb_count allocatedMb = allocated.to_count_of<Mb>();
+//! @endcode
+template <typename T>
+class sharded_count_of
+{
+	struct alignas(detail::cache_line_size) slot
+	{
+		std::atomic<std::size_t> value{ 0 };
+	};
+
+	std::unique_ptr<slot[]> slots_;
+	std::size_t mask_;
+
+public:
+	//! creates one slot per CPU by default. shards is rounded up to a power of two.
+	explicit sharded_count_of(std::size_t shards = std::thread::hardware_concurrency())
+	{
+		std::size_t size = 1;
+		while (size < shards)
+		{
+			size <<= 1;
+		}
+		slots_ = std::make_unique<slot[]>(size);
+		mask_ = size - 1;
+	}
+
+	sharded_count_of(const sharded_count_of&) = delete;
+	sharded_count_of& operator =(const sharded_count_of&) = delete;
+
+	//! adds count to the slot of the current CPU.
+	void add(count_of<T> count) noexcept
+	{
+		slots_[detail::current_cpu() & mask_].value.fetch_add(count.to_size(), std::memory_order_relaxed);
+	}
+
+	//! subtracts count from the slot of the current CPU.
+	//!
+	//! A slot may wrap around but the sum stays correct while the total doesn't go below zero.
+	void sub(count_of<T> count) noexcept
+	{
+		slots_[detail::current_cpu() & mask_].value.fetch_sub(count.to_size(), std::memory_order_relaxed);
+	}
+
+	sharded_count_of& operator +=(count_of<T> count) noexcept
+	{
+		add(count);
+		return *this;
+	}
+
+	sharded_count_of& operator -=(count_of<T> count) noexcept
+	{
+		sub(count);
+		return *this;
+	}
+
+	//! returns the sum of all slots.
+	count_of<T> load() const noexcept
+	{
+		std::size_t sum = 0;
+		for (std::size_t i = 0; i <= mask_; ++i)
+		{
+			sum += slots_[i].value.load(std::memory_order_relaxed);
+		}
+		return count_of<T>(sum);
+	}
+
+	//! returns the sum of all slots converted to count of U.
+	template <typename U>
+	count_of<U> to_count_of() const noexcept
+	{
+		return load().template to_count_of<U>();
+	}
+
+	//! clears all slots. Updates racing with reset() may or may not be kept.
+	void reset() noexcept
+	{
+		for (std::size_t i = 0; i <= mask_; ++i)
+		{
+			slots_[i].value.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	//! returns number of slots.
+	std::size_t shards() const noexcept
+	{
+		return mask_ + 1;
+	}
+};
+
+//! @}
+
+//! @addtogroup typedefs
+//! @{
+
+using atomic_byte_count = atomic_count_of<std::byte>;
+using sharded_byte_count = sharded_count_of<std::byte>;
+
+//! @}
+
+}
@@ -0,0 +1,192 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Bitmap view over 64-bit words indexed by bit_count
+//!
+//! Bit i is bit i % 64 of word i / 64, like in most bitmap indexes. Indexes and results are
+//! counts of bits, so a count of bytes or of words can't be passed as a bit index by mistake.
+//! popcount(), find_first_set() and the &= and |= operators run over whole words with AVX2
+//! kernels selected at runtime. Bits of the last word past count() are never read as set
+//! bits nor modified.
+//! Word is std::uint64_t or const std::uint64_t for a read-only view. Index checks are done
+//! by Check like safe_array.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! const bit_count rows = bit_count(1000000);
+//! auto words = make_unique_safe_array(ceil_count_of<std::uint64_t>(rows));
+//! bit_view matches{ words.get(), rows };
+//! matches.set(bit_count(42));
+//! matches &= bit_view<const std::uint64_t>(deleted_rows_words, rows);	// a bitmap of the same rows
+//! for (auto row = matches.find_first_set(); row < matches.count(); row = matches.find_first_set(row + 1_bit))
+//! {
+//!     visit(row);
+//! }
+//! @endcode
+template <typename Word = std::uint64_t, typename Check = default_bounds_check>
+class bit_view
+{
+	static_assert(std::is_same_v<std::remove_const_t<Word>, std::uint64_t>, "bit_view is a view of 64-bit words");
+
+	static constexpr std::size_t word_bits = 64;
+
+	Word* words_ = nullptr;
+	std::size_t size_ = 0;	//!< size in bits.
+
+public:
+	constexpr bit_view() noexcept = default;
+
+	//! views all bits of words.
+	constexpr bit_view(safe_array<Word, Check> words) noexcept
+		: words_(words.data())
+		, size_(words.count().to_size() * word_bits)
+	{}
+
+	//! views the first size bits of words. size can't exceed the bits of words.
+	constexpr bit_view(safe_array<Word, Check> words, bit_count size) noexcept(Check::nothrow)
+		: words_(words.data())
+		, size_(size.to_size())
+	{
+		Check::check_size(ceil_count_of<std::uint64_t>(size).to_size(), words.count().to_size());
+	}
+
+	//! converts bit_view<std::uint64_t> to bit_view<const std::uint64_t>.
+	template <typename U, std::enable_if_t<std::is_convertible_v<U*, Word*> && !std::is_same_v<U, Word>, int> = 0>
+	constexpr bit_view(const bit_view<U, Check>& other) noexcept
+		: words_(other.words().data())
+		, size_(other.count().to_size())
+	{}
+
+	//! returns the size in bits.
+	constexpr bit_count count() const noexcept
+	{
+		return bit_count(size_);
+	}
+
+	//! returns the words holding the bits. The last one may hold bits past count().
+	constexpr safe_array<Word, Check> words() const noexcept
+	{
+		return { words_, word_count() };
+	}
+
+	constexpr bool test(bit_count idx) const noexcept(Check::nothrow)
+	{
+		Check::check_index(idx.to_size(), size_);
+		return (words_[idx.to_size() / word_bits] >> (idx.to_size() % word_bits)) & 1;
+	}
+
+	constexpr bool operator[](bit_count idx) const noexcept(Check::nothrow)
+	{
+		return test(idx);
+	}
+
+	//! sets a bit to value.
+	void set(bit_count idx, bool value = true) const noexcept(Check::nothrow)
+	{
+		static_assert(!std::is_const_v<Word>, "bits of a read-only view can't be set");
+		Check::check_index(idx.to_size(), size_);
+		const std::uint64_t mask = std::uint64_t(1) << (idx.to_size() % word_bits);
+		Word& word = words_[idx.to_size() / word_bits];
+		word = value ? word | mask : word & ~mask;
+	}
+
+	void reset(bit_count idx) const noexcept(Check::nothrow)
+	{
+		set(idx, false);
+	}
+
+	//! returns the number of set bits.
+	bit_count popcount() const noexcept
+	{
+		const std::size_t full = size_ / word_bits;
+		std::size_t count = detail::bits_popcount(words_, full);
+		if (const std::uint64_t mask = tail_mask())
+		{
+			count += detail::popcount64(words_[full] & mask);
+		}
+		return bit_count(count);
+	}
+
+	//! returns the index of the first set bit at or after from, or count() if there is none.
+	bit_count find_first_set(bit_count from = bit_count(0)) const noexcept
+	{
+		if (from.to_size() >= size_)
+		{
+			return count();
+		}
+		std::size_t word = from.to_size() / word_bits;
+		std::uint64_t bits = words_[word] & (~std::uint64_t(0) << (from.to_size() % word_bits));
+		if (!bits)
+		{
+			word += 1 + detail::bits_find_word(words_ + word + 1, word_count().to_size() - word - 1);
+			if (word == word_count().to_size())
+			{
+				return count();
+			}
+			bits = words_[word];
+		}
+		const std::size_t index = word * word_bits + detail::count_trailing_zeros(bits);
+		return index < size_ ? bit_count(index) : count();
+	}
+
+	//! ands the first count() bits of other into this. other must have at least count() bits.
+	const bit_view& operator &=(bit_view<const std::uint64_t, Check> other) const noexcept(Check::nothrow)
+	{
+		combine<false>(other);
+		return *this;
+	}
+
+	//! ors the first count() bits of other into this. other must have at least count() bits.
+	const bit_view& operator |=(bit_view<const std::uint64_t, Check> other) const noexcept(Check::nothrow)
+	{
+		combine<true>(other);
+		return *this;
+	}
+
+private:
+	constexpr count_of<std::uint64_t> word_count() const noexcept
+	{
+		return ceil_count_of<std::uint64_t>(count());
+	}
+
+	//! mask of the bits of the last word within count(), or 0 if the last word is full.
+	constexpr std::uint64_t tail_mask() const noexcept
+	{
+		return size_ % word_bits ? (std::uint64_t(1) << (size_ % word_bits)) - 1 : 0;
+	}
+
+	template <bool Or>
+	void combine(bit_view<const std::uint64_t, Check> other) const noexcept(Check::nothrow)
+	{
+		static_assert(!std::is_const_v<Word>, "bits of a read-only view can't be set");
+		Check::check_size(size_, other.count().to_size());
+		const std::size_t full = size_ / word_bits;
+		const std::uint64_t* src = other.words().data();
+		detail::bits_combine<Or>(words_, src, full);
+		if (const std::uint64_t mask = tail_mask())
+		{
+			words_[full] = Or ? words_[full] | (src[full] & mask) : words_[full] & (src[full] | ~mask);
+		}
+	}
+};
+
+template <typename Word, typename Check>
+bit_view(safe_array<Word, Check>) -> bit_view<Word, Check>;
+
+template <typename Word, typename Check>
+bit_view(safe_array<Word, Check>, bit_count) -> bit_view<Word, Check>;
+
+//! @}
+
+}
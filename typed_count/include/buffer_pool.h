@@ -0,0 +1,360 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "typed_count_core.h"
+#include "memory_budget.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Statistics of a buffer_pool.
+struct buffer_pool_stats
+{
+	std::size_t hits;			//!< acquires served by a recycled buffer.
+	std::size_t misses;			//!< acquires which had to allocate a new buffer.
+	byte_count bytes_held;		//!< bytes of idle buffers held by the pool.
+	byte_count bytes_allocated;	//!< bytes of all buffers the pool has allocated.
+};
+
+//! Lock-free pool of fixed-size buffers keyed by unit
+//!
+//! buffer_pool<Unit> recycles buffers of exactly count_of<Unit>(1) like 8KB for Page or 1MB for Mb.
+//! Each thread keeps a small cache of idle buffers and exchanges batches of them with
+//! a global lock-free freelist, so acquire() and release() normally don't touch any shared
+//! cache line.
+//! There is one pool per Unit accessed by instance(). It lives until the process exits and
+//! keeps idle buffers, so the memory it holds is the high-water mark of buffers in use.
+//! Buffers are page-aligned.
+//! The freelist head is a pointer with a 64-bit counter updated by a double-width CAS, so it
+//! is immune to ABA. Its links are stored past the end of each buffer where users never write.
+//! GCC implements the double-width CAS in libatomic, which uses cmpxchg16b where the CPU has it.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! auto& pool = buffer_pool<Page>::instance();
+//! safe_array<std::byte> page = pool.acquire();	// page.count() == 1_pg.to_count_of<std::byte>()
+//! pool.release(page);
+//! @endcode
+template <typename Unit>
+class buffer_pool
+{
+	using ratio_t = unit_ratio_t<Unit>;
+	static_assert(ratio_t::den == 1, "buffer size must be whole bytes");
+
+	static constexpr std::size_t alignment = 4096;
+
+	//! freelist link stored after the end of its buffer.
+	struct node
+	{
+		std::atomic<node*> next;
+	};
+
+	//! freelist head with a counter which changes on every update.
+	struct alignas(2 * sizeof(void*)) tagged_head
+	{
+		node* first;
+		std::uintptr_t tag;
+	};
+
+	static constexpr std::size_t buffer_bytes = static_cast<std::size_t>(ratio_t::num);
+	static constexpr std::size_t node_offset = (buffer_bytes + alignof(node) - 1) & ~(alignof(node) - 1);
+
+	//! idle buffers a thread keeps before it spills half of them to the global freelist.
+	static constexpr std::size_t max_cached = buffer_bytes >= 1024 * 1024 ? 4 : (buffer_bytes >= 64 * 1024 ? 16 : 64);
+
+	//! per-thread cache of idle buffers and statistics not yet published.
+	struct thread_cache
+	{
+		node* head = nullptr;
+		std::size_t count = 0;
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::ptrdiff_t in_use = 0;
+
+		~thread_cache()
+		{
+			auto& pool = instance();
+			pool.spill(*this, count);
+			pool.publish(*this);
+		}
+	};
+
+	static inline thread_local thread_cache cache_;
+
+	std::atomic<tagged_head> head_{ tagged_head{ nullptr, 0 } };
+	std::atomic<std::size_t> hits_{ 0 };
+	std::atomic<std::size_t> misses_{ 0 };
+	std::atomic<std::ptrdiff_t> in_use_{ 0 };
+	std::atomic<std::size_t> allocated_{ 0 };
+
+	buffer_pool() noexcept = default;
+
+public:
+	buffer_pool(const buffer_pool&) = delete;
+	buffer_pool& operator =(const buffer_pool&) = delete;
+
+	//! returns the pool of Unit sized buffers.
+	static buffer_pool& instance() noexcept
+	{
+		// Never destroyed so that thread caches can return buffers at any time during exit.
+		static buffer_pool* pool = new buffer_pool();
+		return *pool;
+	}
+
+	//! returns buffer size.
+	static constexpr byte_count buffer_size() noexcept
+	{
+		return byte_count(buffer_bytes);
+	}
+
+	//! acquires a buffer of buffer_size().
+	//!
+	//! Contents of a recycled buffer are unspecified.
+	//! Throws std::bad_alloc if a new buffer can't be allocated.
+	safe_array<std::byte> acquire()
+	{
+		auto& cache = cache_;
+		node* n = cache.head;
+		if (n)
+		{
+			cache.head = n->next.load(std::memory_order_relaxed);
+			--cache.count;
+			++cache.hits;
+		}
+		else if ((n = pop()) != nullptr)
+		{
+			++cache.hits;
+			publish(cache);
+		}
+		else
+		{
+			auto p = static_cast<std::byte*>(::operator new(node_offset + sizeof(node), std::align_val_t(alignment)));
+			n = new (p + node_offset) node;
+			allocated_.fetch_add(buffer_bytes, std::memory_order_relaxed);
+			++cache.misses;
+			publish(cache);
+		}
+		++cache.in_use;
+
+		return { buffer_of(n), buffer_size() };
+	}
+
+	//! returns a buffer acquired from this pool.
+	void release(safe_array<std::byte> buffer) noexcept
+	{
+		assert(buffer.count() == buffer_size() && reinterpret_cast<std::uintptr_t>(buffer.data()) % alignment == 0);
+
+		auto& cache = cache_;
+		auto n = reinterpret_cast<node*>(buffer.data() + node_offset);
+		n->next.store(cache.head, std::memory_order_relaxed);
+		cache.head = n;
+		--cache.in_use;
+		if (++cache.count > max_cached)
+		{
+			spill(cache, cache.count / 2);
+			publish(cache);
+		}
+	}
+
+	//! returns statistics.
+	//!
+	//! Other threads publish their statistics whenever they access the global freelist
+	//! or exit. So, statistics may lag behind by what they have cached.
+	buffer_pool_stats stats() const noexcept
+	{
+		const auto& cache = cache_;
+		const std::size_t allocated = allocated_.load(std::memory_order_relaxed);
+		const std::ptrdiff_t in_use = in_use_.load(std::memory_order_relaxed) + cache.in_use;
+		const std::size_t in_use_bytes = in_use > 0 ? static_cast<std::size_t>(in_use) * buffer_bytes : 0;
+
+		return {
+			hits_.load(std::memory_order_relaxed) + cache.hits,
+			misses_.load(std::memory_order_relaxed) + cache.misses,
+			byte_count(allocated > in_use_bytes ? allocated - in_use_bytes : 0),
+			byte_count(allocated),
+		};
+	}
+
+private:
+	static std::byte* buffer_of(node* n) noexcept
+	{
+		return reinterpret_cast<std::byte*>(n) - node_offset;
+	}
+
+	//! pops a buffer from the global freelist.
+	node* pop() noexcept
+	{
+		tagged_head old_head = head_.load(std::memory_order_acquire);
+		for (;;)
+		{
+			node* n = old_head.first;
+			if (!n)
+			{
+				return nullptr;
+			}
+			// Nodes are never freed, and the tag makes the CAS fail if n was popped meanwhile.
+			const tagged_head new_head{ n->next.load(std::memory_order_relaxed), old_head.tag + 1 };
+			if (head_.compare_exchange_weak(old_head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+			{
+				return n;
+			}
+		}
+	}
+
+	//! moves count buffers from a thread cache to the global freelist with a single CAS.
+	void spill(thread_cache& cache, std::size_t count) noexcept
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		node* first = cache.head;
+		node* last = first;
+		for (std::size_t i = 1; i < count; ++i)
+		{
+			last = last->next.load(std::memory_order_relaxed);
+		}
+		cache.head = last->next.load(std::memory_order_relaxed);
+		cache.count -= count;
+
+		tagged_head old_head = head_.load(std::memory_order_relaxed);
+		tagged_head new_head;
+		do
+		{
+			last->next.store(old_head.first, std::memory_order_relaxed);
+			new_head = { first, old_head.tag + 1 };
+		} while (!head_.compare_exchange_weak(old_head, new_head, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	//! publishes statistics of a thread cache.
+	void publish(thread_cache& cache) noexcept
+	{
+		hits_.fetch_add(cache.hits, std::memory_order_relaxed);
+		misses_.fetch_add(cache.misses, std::memory_order_relaxed);
+		in_use_.fetch_add(cache.in_use, std::memory_order_relaxed);
+		cache.hits = cache.misses = 0;
+		cache.in_use = 0;
+	}
+};
+
+//! Owning buffer acquired from buffer_pool<Unit>
+//!
+//! Returns the buffer to the pool when it goes out of scope. It is move-only.
+//! A buffer can be reserved against a memory_budget while it is held.
+template <typename Unit>
+class pooled_buffer
+{
+	safe_array<std::byte> buffer_;
+	memory_budget* budget_ = nullptr;
+
+public:
+	//! acquires a buffer from buffer_pool<Unit>::instance().
+	pooled_buffer()
+		: buffer_(buffer_pool<Unit>::instance().acquire())
+	{}
+
+	//! acquires a buffer reserved against budget.
+	//!
+	//! Throws std::bad_alloc if the buffer exceeds the budget. The budget must outlive the buffer.
+	explicit pooled_buffer(memory_budget& budget)
+	{
+		const byte_count size = buffer_pool<Unit>::buffer_size();
+		if (!budget.try_reserve(size))
+		{
+			throw std::bad_alloc();
+		}
+		try
+		{
+			buffer_ = buffer_pool<Unit>::instance().acquire();
+		}
+		catch (...)
+		{
+			budget.release(size);
+			throw;
+		}
+		budget_ = &budget;
+	}
+
+	pooled_buffer(const pooled_buffer&) = delete;
+	pooled_buffer& operator =(const pooled_buffer&) = delete;
+
+	pooled_buffer(pooled_buffer&& other) noexcept
+		: buffer_(other.buffer_), budget_(other.budget_)
+	{
+		other.buffer_ = safe_array<std::byte>();
+		other.budget_ = nullptr;
+	}
+
+	pooled_buffer& operator =(pooled_buffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			buffer_ = other.buffer_;
+			budget_ = other.budget_;
+			other.buffer_ = safe_array<std::byte>();
+			other.budget_ = nullptr;
+		}
+		return *this;
+	}
+
+	~pooled_buffer()
+	{
+		reset();
+	}
+
+	//! returns a non-owning view.
+	constexpr safe_array<std::byte> get() const noexcept
+	{
+		return buffer_;
+	}
+
+	//! supports conversion to a non-owning view.
+	constexpr operator safe_array<std::byte>() const noexcept
+	{
+		return buffer_;
+	}
+
+	constexpr byte_count count() const noexcept
+	{
+		return buffer_.count();
+	}
+
+	constexpr std::byte* data() const noexcept
+	{
+		return buffer_.data();
+	}
+
+	constexpr explicit operator bool() const noexcept
+	{
+		return static_cast<bool>(buffer_);
+	}
+
+	//! returns the buffer to the pool early.
+	void reset() noexcept
+	{
+		if (buffer_.data())
+		{
+			buffer_pool<Unit>::instance().release(buffer_);
+			buffer_ = safe_array<std::byte>();
+		}
+		if (budget_)
+		{
+			budget_->release(buffer_pool<Unit>::buffer_size());
+			budget_ = nullptr;
+		}
+	}
+};
+
+//! @}
+
+}
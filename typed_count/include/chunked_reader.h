@@ -0,0 +1,410 @@
+﻿#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <system_error>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "typed_count_core.h"
+#include "buffer_pool.h"
+#include "aligned_array.h"
+#include "io_uring_queue.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! I/O backend of chunked_reader.
+enum class io_backend
+{
+	automatic,		//!< io_uring if available, synchronous reads otherwise.
+	synchronous,	//!< pread() with sequential read-ahead advice.
+};
+
+//! Streaming reader handing out a file in chunks of one Unit
+//!
+//! chunked_reader<Kb> reads a file or fd in chunks of a count_of<Kb> like 64_kb, one Unit
+//! by default. next() returns a chunk as
+//! safe_array<const std::byte> while the following Depth - 1 chunks are already being read
+//! by io_uring, so I/O and the consumer overlap. Without io_uring, chunks are read by pread()
+//! and the kernel read-ahead is advised instead.
+//! Chunks of one Unit come from buffer_pool<Unit>, so readers in a steady state don't allocate.
+//! Larger chunks are page-aligned arrays allocated by each reader.
+//! The fd must support pread() like a regular file.
+//! Throws std::system_error on I/O errors.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! chunked_reader<Kb> reader{ "access.log", 256_kb };
+//! while (auto chunk = reader.next())
+//! {
+//!     parse(chunk);		// chunk is valid until the next call to next().
+//! }
+//! @endcode
+template <typename Unit, std::size_t Depth = 2>
+class chunked_reader
+{
+	static_assert(Depth >= 1);
+
+	//! chunk buffer of one pooled Unit or of a larger aligned array.
+	struct chunk_buffer
+	{
+		std::optional<pooled_buffer<Unit>> pooled;
+		unique_aligned_safe_array<std::byte> owned;
+
+		std::byte* data() const noexcept
+		{
+			return pooled ? pooled->data() : owned.data();
+		}
+	};
+
+	struct slot
+	{
+		chunk_buffer buffer;
+		std::uint64_t offset = 0;	//!< file offset of the chunk.
+		std::size_t filled = 0;		//!< bytes read so far.
+		bool pending = false;		//!< a read is in flight or not yet done.
+		int error = 0;
+#if !defined(_WIN32)
+		iovec iov{};
+#endif
+	};
+
+#if defined(_WIN32)
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+#endif
+	int fd_ = -1;
+	bool owns_fd_ = false;
+	std::size_t chunk_bytes_;
+#if defined(__linux__)
+	std::unique_ptr<detail::io_uring_queue> ring_;
+#endif
+	slot slots_[Depth];
+	std::size_t head_ = 0;
+	bool returned_ = false;
+	bool eof_ = false;
+	std::uint64_t next_offset_ = 0;
+
+public:
+	//! reads a file descriptor opened for reading in chunks of one Unit. The fd is not closed.
+	explicit chunked_reader(int fd, io_backend backend = io_backend::automatic)
+		: chunked_reader(fd, count_of<Unit>(1), backend)
+	{}
+
+	//! reads a file descriptor opened for reading in chunks of chunk_size. The fd is not closed.
+	//!
+	//! chunk_size must not be 0.
+	chunked_reader(int fd, count_of<Unit> chunk_size, io_backend backend = io_backend::automatic)
+		: fd_(fd), chunk_bytes_(chunk_size.to_byte_count())
+	{
+		init(chunk_size, backend);
+	}
+
+	//! opens and reads a file in chunks of one Unit.
+	explicit chunked_reader(const char* path, io_backend backend = io_backend::automatic)
+		: chunked_reader(path, count_of<Unit>(1), backend)
+	{}
+
+	//! opens and reads a file in chunks of chunk_size, which must not be 0.
+	chunked_reader(const char* path, count_of<Unit> chunk_size, io_backend backend = io_backend::automatic)
+		: chunk_bytes_(chunk_size.to_byte_count())
+	{
+#if defined(_WIN32)
+		fd_ = ::_open(path, _O_RDONLY | _O_BINARY);
+#else
+		fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+#endif
+		if (fd_ < 0)
+		{
+			throw std::system_error(errno, std::generic_category(), path);
+		}
+		owns_fd_ = true;
+		try
+		{
+			init(chunk_size, backend);
+		}
+		catch (...)
+		{
+			// The destructor doesn't run for a constructor which throws.
+			close_fd();
+			throw;
+		}
+	}
+
+	chunked_reader(const chunked_reader&) = delete;
+	chunked_reader& operator =(const chunked_reader&) = delete;
+
+	~chunked_reader()
+	{
+#if defined(__linux__)
+		// The kernel may still write to the buffers.
+		if (ring_)
+		{
+			for (auto& s : slots_)
+			{
+				while (s.pending && wait_any() == 0)
+				{}
+			}
+			// Closes the ring before the buffers are freed.
+			ring_.reset();
+		}
+#endif
+		close_fd();
+	}
+
+	//! returns chunk size.
+	byte_count chunk_size() const noexcept
+	{
+		return byte_count(chunk_bytes_);
+	}
+
+	//! true if chunks are read by io_uring.
+	bool uses_io_uring() const noexcept
+	{
+#if defined(__linux__)
+		return ring_ != nullptr;
+#else
+		return false;
+#endif
+	}
+
+	//! returns the next chunk or an empty safe_array at the end of file.
+	//!
+	//! Every chunk but the last has chunk_size(). The chunk stays valid until the next call.
+	safe_array<const std::byte> next()
+	{
+		if (returned_)
+		{
+			// The consumer is done with the previous chunk. Reuses its buffer for a read ahead.
+			start(slots_[(head_ + Depth - 1) % Depth]);
+		}
+
+		slot& s = slots_[head_];
+		complete(s);
+		if (s.error)
+		{
+			const int error = s.error;
+			s.error = 0;
+			throw std::system_error(error, std::generic_category(), "chunked_reader");
+		}
+
+		returned_ = true;
+		head_ = (head_ + 1) % Depth;
+		return { s.buffer.data(), byte_count(s.filled) };
+	}
+
+private:
+	void close_fd() noexcept
+	{
+		if (owns_fd_)
+		{
+#if defined(_WIN32)
+			::_close(fd_);
+#else
+			::close(fd_);
+#endif
+			owns_fd_ = false;
+		}
+	}
+
+	void init(count_of<Unit> chunk_size, io_backend backend)
+	{
+		assert(chunk_size > count_of<Unit>(0));
+		for (auto& s : slots_)
+		{
+			if (chunk_size == count_of<Unit>(1))
+			{
+				s.buffer.pooled.emplace();
+			}
+			else
+			{
+				s.buffer.owned = make_aligned_safe_array(byte_count(chunk_bytes_), 4096_bt);
+			}
+		}
+#if defined(_WIN32)
+		file_ = reinterpret_cast<HANDLE>(::_get_osfhandle(fd_));
+		(void)backend;
+#else
+#if defined(__linux__)
+		if (backend == io_backend::automatic)
+		{
+			ring_ = std::make_unique<detail::io_uring_queue>(static_cast<unsigned>(Depth));
+			if (!ring_->valid())
+			{
+				ring_.reset();
+			}
+		}
+#else
+		(void)backend;
+#endif
+#if defined(POSIX_FADV_SEQUENTIAL)
+		if (!uses_io_uring())
+		{
+			::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+#endif
+#endif
+		for (auto& s : slots_)
+		{
+			start(s);
+		}
+	}
+
+	//! starts reading the next chunk into a slot.
+	void start(slot& s)
+	{
+		s.filled = 0;
+		s.error = 0;
+		s.pending = !eof_;
+		if (!s.pending)
+		{
+			return;
+		}
+		s.offset = next_offset_;
+		next_offset_ += chunk_bytes_;
+		submit(s);
+	}
+
+	//! submits a read of the rest of a slot to io_uring. Synchronous reads are done by complete().
+	void submit(slot& s)
+	{
+#if defined(__linux__)
+		if (ring_)
+		{
+			s.iov.iov_base = s.buffer.data() + s.filled;
+			s.iov.iov_len = chunk_bytes_ - s.filled;
+			io_uring_sqe* sqe = ring_->get_sqe();
+			if (!sqe)
+			{
+				// The queue may still hold entries the kernel didn't take.
+				const int r = ring_->submit();
+				sqe = r < 0 ? nullptr : ring_->get_sqe();
+				if (!sqe)
+				{
+					// Nothing is queued for the slot, so it is done.
+					s.pending = false;
+					s.error = r < 0 ? -r : EBUSY;
+					return;
+				}
+			}
+			sqe->opcode = IORING_OP_READV;
+			sqe->fd = fd_;
+			sqe->addr = reinterpret_cast<std::uint64_t>(&s.iov);
+			sqe->len = 1;
+			sqe->off = s.offset + s.filled;
+			sqe->user_data = static_cast<std::uint64_t>(&s - slots_);
+			// The read stays queued if the kernel doesn't take it now, and the next wait
+			// submits it again. So the slot is pending either way.
+			ring_->submit();
+		}
+#else
+		(void)s;
+#endif
+	}
+
+	//! accounts a read result of a slot. Resubmits the rest of the chunk after a short read.
+	void on_read(slot& s, long long result)
+	{
+		if (result < 0)
+		{
+			s.pending = false;
+			s.error = static_cast<int>(-result);
+		}
+		else if (result == 0)
+		{
+			s.pending = false;
+			eof_ = true;
+		}
+		else
+		{
+			s.filled += static_cast<std::size_t>(result);
+			s.pending = s.filled < chunk_bytes_;
+			if (s.pending && uses_io_uring())
+			{
+				submit(s);
+			}
+		}
+	}
+
+	//! waits for any io_uring completion and accounts it. Returns 0 or a negative errno.
+	int wait_any() noexcept
+	{
+#if defined(__linux__)
+		io_uring_cqe cqe;
+		if (const int r = ring_->wait(cqe))
+		{
+			return r;
+		}
+		on_read(slots_[cqe.user_data], cqe.res);
+		return 0;
+#else
+		return -ENOSYS;
+#endif
+	}
+
+	//! waits until a slot has a full chunk, hits the end of file or fails.
+	void complete(slot& s)
+	{
+		while (s.pending)
+		{
+			if (uses_io_uring())
+			{
+				// The read may still be queued after a failed wait, so the slot stays pending.
+				if (const int r = wait_any())
+				{
+					throw std::system_error(-r, std::generic_category(), "io_uring_enter");
+				}
+				continue;
+			}
+			on_read(s, read_at(s.buffer.data() + s.filled, chunk_bytes_ - s.filled, s.offset + s.filled));
+		}
+	}
+
+	//! synchronous positional read. Returns bytes read or a negative errno.
+	long long read_at(std::byte* p, std::size_t bytes, std::uint64_t offset) noexcept
+	{
+#if defined(_WIN32)
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD read = 0;
+		const DWORD len = bytes > 0x40000000 ? 0x40000000 : static_cast<DWORD>(bytes);
+		if (!::ReadFile(file_, p, len, &read, &overlapped))
+		{
+			return ::GetLastError() == ERROR_HANDLE_EOF ? 0 : -EIO;
+		}
+		return read;
+#else
+		for (;;)
+		{
+			const ssize_t r = ::pread(fd_, p, bytes, static_cast<off_t>(offset));
+			if (r >= 0 || errno != EINTR)
+			{
+				return r >= 0 ? r : -errno;
+			}
+		}
+#endif
+	}
+};
+
+//! @}
+
+}
@@ -0,0 +1,198 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Column of counts of T stored contiguously as Rep
+//!
+//! A struct-of-arrays container for a large number of counts like the lengths of records.
+//! Elements are read and written as count_of<T, Rep> and indexed by typed counts of elements
+//! checked by Check like safe_array, while they are stored as plain Rep so that bulk
+//! operations run over them as vectors. sum(), max(), convert_all() and prefix_sum() use
+//! AVX2 kernels selected at runtime for 4 and 8 byte Rep, and scalar loops otherwise.
+//! Sums and conversions wrap around like wrap_policy does.
+//! Elements are allocated from a memory resource, which is the heap by default.
+//! Allocation failures throw std::bad_alloc.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! count_column<char, std::uint32_t> lengths;
+//! for (const auto& record : records) { lengths.push_back(char_count32(record.size())); }
+//! const char_count total = lengths.sum();					// one pass of vector adds
+//! const auto offsets = lengths.prefix_sum();				// start of each record when packed
+//! const auto sizes = lengths.convert_all<std::byte>();	// bytes of each record
+//! @endcode
+template <typename T, typename Rep = std::size_t, typename Check = default_bounds_check>
+class count_column
+{
+	static_assert(std::is_unsigned_v<Rep> && !std::is_same_v<Rep, bool>);
+
+public:
+	using value_type = count_of<T, Rep>;
+	using index_t = count_of<value_type>;
+
+private:
+	std::pmr::vector<Rep> elems_;
+
+public:
+	//! creates an empty column.
+	explicit count_column(std::pmr::memory_resource* resource = std::pmr::new_delete_resource()) noexcept
+		: elems_(resource)
+	{}
+
+	//! creates a column of count zero counts.
+	explicit count_column(index_t count, std::pmr::memory_resource* resource = std::pmr::new_delete_resource())
+		: elems_(count.to_size(), Rep(0), resource)
+	{}
+
+	count_column(std::initializer_list<value_type> counts, std::pmr::memory_resource* resource = std::pmr::new_delete_resource())
+		: elems_(resource)
+	{
+		elems_.reserve(counts.size());
+		for (value_type count : counts)
+		{
+			elems_.push_back(static_cast<Rep>(count.to_size()));
+		}
+	}
+
+	//! returns the number of elements.
+	index_t count() const noexcept
+	{
+		return index_t(elems_.size());
+	}
+
+	bool empty() const noexcept
+	{
+		return elems_.empty();
+	}
+
+	//! returns indexes of the elements as typed counts.
+	count_range<value_type> indices() const noexcept
+	{
+		return { index_t(0), count() };
+	}
+
+	value_type operator[](index_t idx) const noexcept(Check::nothrow)
+	{
+		Check::check_index(idx.to_size(), elems_.size());
+		return value_type(elems_[idx.to_size()]);
+	}
+
+	void set(index_t idx, value_type value) noexcept(Check::nothrow)
+	{
+		Check::check_index(idx.to_size(), elems_.size());
+		elems_[idx.to_size()] = static_cast<Rep>(value.to_size());
+	}
+
+	void push_back(value_type value)
+	{
+		elems_.push_back(static_cast<Rep>(value.to_size()));
+	}
+
+	void reserve(index_t count)
+	{
+		elems_.reserve(count.to_size());
+	}
+
+	//! resizes to count elements. New elements are zero counts.
+	void resize(index_t count)
+	{
+		elems_.resize(count.to_size());
+	}
+
+	void clear() noexcept
+	{
+		elems_.clear();
+	}
+
+	//! returns the elements as plain Rep, for I/O or kernels of the caller.
+	safe_array<Rep, Check> raw() noexcept
+	{
+		return { elems_.data(), count_of<Rep>(elems_.size()) };
+	}
+
+	safe_array<const Rep, Check> raw() const noexcept
+	{
+		return { elems_.data(), count_of<Rep>(elems_.size()) };
+	}
+
+	std::pmr::memory_resource* resource() const noexcept
+	{
+		return elems_.get_allocator().resource();
+	}
+
+	//! returns the sum of all elements.
+	count_of<T> sum() const noexcept
+	{
+		return count_of<T>(detail::column_sum(elems_.data(), elems_.size()));
+	}
+
+	//! returns the largest element, or 0 if the column is empty.
+	value_type max() const noexcept
+	{
+		return value_type(detail::column_max(elems_.data(), elems_.size()));
+	}
+
+	//! converts all elements to counts of U like to_count_of<U>() does and returns them.
+	//!
+	//! The result Rep is the Rep of to_count_of<U>(), which is wider than Rep if a converted
+	//! count may not fit in Rep. Conversions between units whose sizes are powers of two are
+	//! vector shifts. Others convert element by element.
+	template <typename U>
+	auto convert_all() const
+	{
+		using to_t = std::remove_cv_t<U>;
+		using to_rep_t = typename decltype(value_type().template to_count_of<to_t>())::rep_t;
+		count_column<to_t, to_rep_t, Check> result(count_of<count_of<to_t, to_rep_t>>(elems_.size()), resource());
+		to_rep_t* dst = result.raw().data();
+
+		const auto ratio = detail::conversion_ratio<T, to_t>();
+		if (detail::is_power_of_two(ratio.num) && detail::is_power_of_two(ratio.den))
+		{
+			const unsigned mul_shift = detail::count_trailing_zeros(ratio.num);
+			const unsigned div_shift = detail::count_trailing_zeros(ratio.den);
+			if (mul_shift >= div_shift)
+			{
+				detail::column_shift<true>(elems_.data(), elems_.size(), dst, mul_shift - div_shift);
+			}
+			else
+			{
+				detail::column_shift<false>(elems_.data(), elems_.size(), dst, div_shift - mul_shift);
+			}
+		}
+		else
+		{
+			for (std::size_t i = 0; i < elems_.size(); ++i)
+			{
+				dst[i] = static_cast<to_rep_t>(value_type(elems_[i]).template to_count_of<to_t>().to_size());
+			}
+		}
+		return result;
+	}
+
+	//! returns the sum of the elements before each element.
+	//!
+	//! These are the offsets of the elements when they are packed back to back, so element i
+	//! of a packed buffer is at prefix_sum()[i] and its total size is sum().
+	count_column<T, std::size_t, Check> prefix_sum() const
+	{
+		count_column<T, std::size_t, Check> offsets(count_of<count_of<T>>(elems_.size()), resource());
+		detail::column_exclusive_scan(elems_.data(), elems_.size(), offsets.raw().data());
+		return offsets;
+	}
+};
+
+//! @}
+
+}
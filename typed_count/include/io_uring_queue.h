@@ -0,0 +1,221 @@
+﻿#pragma once
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace typed_count::detail
+{
+
+//! Minimal io_uring submission and completion queue
+//!
+//! Talks to the kernel through raw system calls, so it doesn't depend on liburing.
+//! valid() is false if the kernel doesn't support io_uring or it is blocked like in some
+//! containers. Callers must fall back to synchronous I/O in that case.
+//! It is not thread-safe.
+class io_uring_queue
+{
+	int fd_ = -1;
+
+	void* sq_ring_ = nullptr;
+	std::size_t sq_ring_size_ = 0;
+	void* cq_ring_ = nullptr;
+	std::size_t cq_ring_size_ = 0;
+	io_uring_sqe* sqes_ = nullptr;
+	std::size_t sqes_size_ = 0;
+
+	unsigned* sq_head_ = nullptr;
+	unsigned* sq_tail_ = nullptr;
+	unsigned sq_mask_ = 0;
+	unsigned* sq_array_ = nullptr;
+	unsigned* cq_head_ = nullptr;
+	unsigned* cq_tail_ = nullptr;
+	unsigned cq_mask_ = 0;
+	io_uring_cqe* cqes_ = nullptr;
+
+	unsigned pending_ = 0;		//!< queued entries not published to the kernel yet.
+	unsigned unsubmitted_ = 0;	//!< published entries the kernel hasn't taken yet.
+
+public:
+	//! sets up a queue with at least entries submission entries.
+	explicit io_uring_queue(unsigned entries) noexcept
+	{
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+		const long fd = ::syscall(__NR_io_uring_setup, entries, &params);
+		if (fd < 0)
+		{
+			return;
+		}
+		fd_ = static_cast<int>(fd);
+
+		sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single_mmap)
+		{
+			sq_ring_size_ = cq_ring_size_ = sq_ring_size_ > cq_ring_size_ ? sq_ring_size_ : cq_ring_size_;
+		}
+
+		sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+		cq_ring_ = single_mmap ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+		sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+		sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+		if (!sq_ring_ || !cq_ring_ || !sqes_)
+		{
+			close();
+			return;
+		}
+
+		auto sq = static_cast<unsigned char*>(sq_ring_);
+		sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+		auto cq = static_cast<unsigned char*>(cq_ring_);
+		cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	}
+
+	io_uring_queue(const io_uring_queue&) = delete;
+	io_uring_queue& operator =(const io_uring_queue&) = delete;
+
+	~io_uring_queue()
+	{
+		close();
+	}
+
+	//! true if the queue is usable.
+	bool valid() const noexcept
+	{
+		return fd_ >= 0;
+	}
+
+	//! returns a cleared submission entry to fill or nullptr if the queue is full.
+	//!
+	//! The entry is sent to the kernel by the next submit().
+	io_uring_sqe* get_sqe() noexcept
+	{
+		const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+		const unsigned tail = *sq_tail_ + pending_;
+		if (tail - head > sq_mask_)
+		{
+			return nullptr;
+		}
+
+		const unsigned index = tail & sq_mask_;
+		io_uring_sqe* sqe = &sqes_[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		sq_array_[index] = index;
+		++pending_;
+		return sqe;
+	}
+
+	//! submits queued entries and waits until at least wait_nr completions are available.
+	//!
+	//! Returns the number of entries the kernel took or a negative errno. The kernel may take
+	//! fewer than queued, like under -EBUSY backpressure. The rest stay in the queue and are
+	//! submitted again by the next call.
+	int submit(unsigned wait_nr = 0) noexcept
+	{
+		if (pending_)
+		{
+			__atomic_store_n(sq_tail_, *sq_tail_ + pending_, __ATOMIC_RELEASE);
+			unsubmitted_ += pending_;
+			pending_ = 0;
+		}
+		const unsigned to_submit = unsubmitted_;
+		if (!to_submit && !wait_nr)
+		{
+			return 0;
+		}
+
+		for (;;)
+		{
+			const long r = ::syscall(__NR_io_uring_enter, fd_, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (r >= 0)
+			{
+				unsubmitted_ -= static_cast<unsigned>(r);
+				return static_cast<int>(r);
+			}
+			if (errno != EINTR)
+			{
+				return -errno;
+			}
+		}
+	}
+
+	//! pops a completion if there is one.
+	bool peek(io_uring_cqe& cqe) noexcept
+	{
+		const unsigned head = *cq_head_;
+		if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+		{
+			return false;
+		}
+		cqe = cqes_[head & cq_mask_];
+		__atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	//! submits queued entries and waits for a completion.
+	//!
+	//! Returns 0 or a negative errno.
+	int wait(io_uring_cqe& cqe) noexcept
+	{
+		while (!peek(cqe))
+		{
+			const int r = submit(1);
+			if (r < 0)
+			{
+				return r;
+			}
+		}
+		return 0;
+	}
+
+private:
+	void* map(std::size_t size, long long offset) noexcept
+	{
+		void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+		return p == MAP_FAILED ? nullptr : p;
+	}
+
+	void close() noexcept
+	{
+		if (sqes_)
+		{
+			::munmap(sqes_, sqes_size_);
+		}
+		if (cq_ring_ && cq_ring_ != sq_ring_)
+		{
+			::munmap(cq_ring_, cq_ring_size_);
+		}
+		if (sq_ring_)
+		{
+			::munmap(sq_ring_, sq_ring_size_);
+		}
+		sqes_ = nullptr;
+		sq_ring_ = cq_ring_ = nullptr;
+		if (fd_ >= 0)
+		{
+			::close(fd_);
+			fd_ = -1;
+		}
+	}
+};
+
+}
+
+#endif
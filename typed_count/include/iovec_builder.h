@@ -0,0 +1,263 @@
+﻿#pragma once
+
+#if !defined(_WIN32)
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <stdexcept>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Scatter/gather list built from safe arrays
+//!
+//! Records each view as a base and a byte count, so that a frame assembled from many
+//! fragments is written by one writev() or sendmsg() without copying it into a single buffer.
+//! Holds up to N entries without allocating and throws std::length_error beyond them.
+//! The views must outlive the builder.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! iovec_builder<> frame;
+//! frame.add(header).add(safe_array<const char>(payload, payloadLen)).add(trailer);
+//! byte_count sent = frame.total();
+//! send_all(sock, frame);
+//! @endcode
+template <std::size_t N = 16>
+class iovec_builder
+{
+	static_assert(N > 0);
+#if defined(IOV_MAX)
+	static_assert(N <= IOV_MAX, "writev() accepts at most IOV_MAX entries");
+#endif
+
+	iovec entries_[N];
+	std::size_t size_ = 0;
+	std::size_t total_ = 0;
+
+public:
+	//! appends a view. Empty views are skipped.
+	//!
+	//! Views of non-const elements can be filled by read_all().
+	//! Throws std::length_error if the builder is full().
+	template <typename T>
+	iovec_builder& add(safe_array<T> view)
+	{
+		const std::size_t bytes = view.count().to_byte_count();
+		if (bytes)
+		{
+			if (full())
+			{
+				throw std::length_error("iovec_builder is full");
+			}
+			entries_[size_++] = { const_cast<std::remove_cv_t<T>*>(view.data()), bytes };
+			total_ += bytes;
+		}
+		return *this;
+	}
+
+	//! appends a fixed size array.
+	template <typename T, std::size_t M>
+	iovec_builder& add(const fixed_size_array<T, M>& array)
+	{
+		return add(safe_array<const T>(array));
+	}
+
+	//! returns total size of the views.
+	byte_count total() const noexcept
+	{
+		return byte_count(total_);
+	}
+
+	//! returns number of entries.
+	count_of<iovec> size() const noexcept
+	{
+		return count_of<iovec>(size_);
+	}
+
+	//! true if no more entries can be added.
+	bool full() const noexcept
+	{
+		return size_ == N;
+	}
+
+	//! returns the entries for writev(), readv() or msghdr.
+	safe_array<iovec> entries() noexcept
+	{
+		return { entries_, size_ };
+	}
+
+	void clear() noexcept
+	{
+		size_ = 0;
+		total_ = 0;
+	}
+};
+
+namespace detail
+{
+
+//! drops transferred bytes from the front of a scatter/gather list.
+inline void advance_entries(safe_array<iovec>& entries, std::size_t bytes) noexcept
+{
+	while (entries && bytes >= (*entries).iov_len)
+	{
+		bytes -= (*entries).iov_len;
+		entries += count_of<iovec>(1);
+	}
+	if (bytes)
+	{
+		(*entries).iov_base = static_cast<char*>((*entries).iov_base) + bytes;
+		(*entries).iov_len -= bytes;
+	}
+}
+
+//! repeats a scatter/gather transfer until all entries are done.
+//!
+//! Returns bytes transferred, which is less than requested only if stop_at_eof and the input ends.
+template <typename Transfer>
+std::size_t transfer_all(safe_array<iovec> entries, Transfer transfer, bool stop_at_eof, const char* what)
+{
+	std::size_t done = 0;
+	while (entries)
+	{
+		const ssize_t r = transfer(entries.data(), entries.count().to_int());
+		if (r < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+		if (r == 0)
+		{
+			if (stop_at_eof)
+			{
+				break;
+			}
+			throw std::system_error(EIO, std::generic_category(), what);
+		}
+		done += static_cast<std::size_t>(r);
+		advance_entries(entries, static_cast<std::size_t>(r));
+	}
+	return done;
+}
+
+}
+
+//! writes all views of a builder by writev(), handling partial writes.
+//!
+//! The builder is cleared. Throws std::system_error on failure.
+template <std::size_t N>
+void write_all(int fd, iovec_builder<N>& builder)
+{
+	detail::transfer_all(builder.entries(), [fd](const iovec* iov, int count) { return ::writev(fd, iov, count); }, false, "writev");
+	builder.clear();
+}
+
+//! sends all views of a builder to a socket by sendmsg(), handling partial sends.
+//!
+//! MSG_NOSIGNAL is added where it exists, so a closed peer throws EPIPE instead of raising SIGPIPE.
+//! The builder is cleared. Throws std::system_error on failure.
+template <std::size_t N>
+void send_all(int socket, iovec_builder<N>& builder, int flags = 0)
+{
+#if defined(MSG_NOSIGNAL)
+	flags |= MSG_NOSIGNAL;
+#endif
+	detail::transfer_all(builder.entries(), [socket, flags](const iovec* iov, int count)
+	{
+		msghdr message{};
+		message.msg_iov = const_cast<iovec*>(iov);
+		message.msg_iovlen = count;
+		return ::sendmsg(socket, &message, flags);
+	}, false, "sendmsg");
+	builder.clear();
+}
+
+//! fills all views of a builder by readv() until they are full or the input ends.
+//!
+//! Returns bytes read. The builder is cleared. Throws std::system_error on failure.
+template <std::size_t N>
+byte_count read_all(int fd, iovec_builder<N>& builder)
+{
+	const std::size_t bytes = detail::transfer_all(builder.entries(), [fd](const iovec* iov, int count) { return ::readv(fd, iov, count); }, true, "readv");
+	builder.clear();
+	return byte_count(bytes);
+}
+
+//! writes a whole safe array, handling partial writes.
+//!
+//! Throws std::system_error on failure.
+template <typename T>
+void write_all(int fd, safe_array<T> data)
+{
+	safe_array<const std::byte> rest(reinterpret_cast<const std::byte*>(data.data()), byte_count(data.count().to_byte_count()));
+	while (rest)
+	{
+		const ssize_t r = ::write(fd, rest.data(), rest.count().to_size());
+		if (r < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "write");
+		}
+		if (r == 0)
+		{
+			throw std::system_error(EIO, std::generic_category(), "write");
+		}
+		rest += byte_count(static_cast<std::size_t>(r));
+	}
+}
+
+//! reads into a safe array until it is full or the input ends.
+//!
+//! Returns number of whole elements read. Bytes of a trailing partial element are stored but not counted.
+//! Throws std::system_error on failure.
+template <typename T>
+count_of<std::remove_cv_t<T>> read_all(int fd, safe_array<T> data)
+{
+	static_assert(!std::is_const_v<T>);
+
+	safe_array<std::byte> rest(reinterpret_cast<std::byte*>(data.data()), byte_count(data.count().to_byte_count()));
+	std::size_t done = 0;
+	while (rest)
+	{
+		const ssize_t r = ::read(fd, rest.data(), rest.count().to_size());
+		if (r < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "read");
+		}
+		if (r == 0)
+		{
+			break;
+		}
+		done += static_cast<std::size_t>(r);
+		rest += byte_count(static_cast<std::size_t>(r));
+	}
+	return count_of<std::remove_cv_t<T>>(done / sizeof(T));
+}
+
+//! @}
+
+}
+
+#endif
@@ -0,0 +1,351 @@
+﻿#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "typed_count_core.h"
+#include "page_units.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Access pattern advice for a mapped_file.
+enum class map_advice
+{
+	normal,			//!< no special treatment.
+	sequential,		//!< read ahead aggressively and drop pages soon after they are read.
+	random,			//!< don't read ahead.
+	willneed,		//!< start reading the whole mapping in now.
+	hugepage,		//!< back the mapping by transparent huge pages if the file system supports it.
+};
+
+//! Read-only memory-mapped view of a file
+//!
+//! mapped_file<T> exposes the mapped file as safe_array<const T> without copying it.
+//! count() is in T and a trailing partial element is not accessible.
+//! The mapping is released when it goes out of scope. It is move-only.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! auto index = map_file<std::uint64_t>("index.bin");
+//! index.advise(map_advice::sequential);
+//! for (auto i = count_of<std::uint64_t>(0); i < index.count(); ++i) { sum += index[i]; }
+//! @endcode
+template <typename T>
+class mapped_file
+{
+	using count_t = count_of<std::remove_cv_t<T>>;
+
+	void* base_ = nullptr;
+	std::size_t mapped_bytes_ = 0;
+	safe_array<const T> view_;
+
+public:
+	constexpr mapped_file() noexcept = default;
+
+	//! takes ownership of a mapping created by mappable_file.
+	mapped_file(void* base, std::size_t mapped_bytes, safe_array<const T> view) noexcept
+		: base_(base), mapped_bytes_(mapped_bytes), view_(view)
+	{}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator =(const mapped_file&) = delete;
+
+	mapped_file(mapped_file&& other) noexcept
+		: base_(std::exchange(other.base_, nullptr)),
+		mapped_bytes_(std::exchange(other.mapped_bytes_, 0)),
+		view_(std::exchange(other.view_, safe_array<const T>()))
+	{}
+
+	mapped_file& operator =(mapped_file&& other) noexcept
+	{
+		if (this != &other)
+		{
+			unmap();
+			base_ = std::exchange(other.base_, nullptr);
+			mapped_bytes_ = std::exchange(other.mapped_bytes_, 0);
+			view_ = std::exchange(other.view_, safe_array<const T>());
+		}
+		return *this;
+	}
+
+	~mapped_file()
+	{
+		unmap();
+	}
+
+	//! returns a non-owning view.
+	constexpr safe_array<const T> get() const noexcept
+	{
+		return view_;
+	}
+
+	//! supports conversion to a non-owning view.
+	constexpr operator safe_array<const T>() const noexcept
+	{
+		return view_;
+	}
+
+	constexpr const T& operator[](count_t idx) const
+	{
+		return view_[idx];
+	}
+
+	constexpr count_t count() const noexcept
+	{
+		return view_.count();
+	}
+
+	constexpr const T* data() const noexcept
+	{
+		return view_.data();
+	}
+
+	constexpr explicit operator bool() const noexcept
+	{
+		return static_cast<bool>(view_);
+	}
+
+	//! returns length of the mapping in the pages of the OS.
+	//!
+	//! The mapping starts at a page boundary before data() if the view has an offset.
+	os_page_count mapped_pages() const noexcept
+	{
+		return round_up_to<OsPage>(byte_count(mapped_bytes_)).template to_count_of<OsPage>();
+	}
+
+	//! advises the OS about the access pattern of the mapping.
+	//!
+	//! Returns false if the advice is not supported.
+	bool advise(map_advice advice) const noexcept
+	{
+		if (!base_)
+		{
+			return false;
+		}
+#if defined(_WIN32)
+		if (advice == map_advice::willneed)
+		{
+			WIN32_MEMORY_RANGE_ENTRY range{ base_, mapped_bytes_ };
+			return ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0) != 0;
+		}
+		return advice == map_advice::normal;
+#else
+		int native;
+		switch (advice)
+		{
+		case map_advice::sequential:
+			native = MADV_SEQUENTIAL;
+			break;
+		case map_advice::random:
+			native = MADV_RANDOM;
+			break;
+		case map_advice::willneed:
+			native = MADV_WILLNEED;
+			break;
+		case map_advice::hugepage:
+#if defined(MADV_HUGEPAGE)
+			native = MADV_HUGEPAGE;
+			break;
+#else
+			return false;
+#endif
+		default:
+			native = MADV_NORMAL;
+			break;
+		}
+		return ::madvise(base_, mapped_bytes_, native) == 0;
+#endif
+	}
+
+private:
+	void unmap() noexcept
+	{
+		if (base_)
+		{
+#if defined(_WIN32)
+			::UnmapViewOfFile(base_);
+#else
+			::munmap(base_, mapped_bytes_);
+#endif
+			base_ = nullptr;
+		}
+	}
+};
+
+//! Read-only file which can be mapped in windows
+//!
+//! Keeps the file open so that multiple windows can be mapped by map_range().
+//! Mappings stay valid after the mappable_file is closed.
+//! Throws std::system_error if the file can't be opened or mapped.
+class mappable_file
+{
+#if defined(_WIN32)
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+	std::size_t size_ = 0;
+
+public:
+	//! opens a file for reading.
+	explicit mappable_file(const char* path)
+	{
+#if defined(_WIN32)
+		file_ = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size;
+		if (file_ == INVALID_HANDLE_VALUE || !::GetFileSizeEx(file_, &size))
+		{
+			const auto error = static_cast<int>(::GetLastError());
+			close();
+			throw std::system_error(error, std::system_category(), path);
+		}
+		size_ = static_cast<std::size_t>(size.QuadPart);
+		if (size_ > 0 && !(mapping_ = ::CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr)))
+		{
+			const auto error = static_cast<int>(::GetLastError());
+			close();
+			throw std::system_error(error, std::system_category(), path);
+		}
+#else
+		fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if (fd_ < 0 || ::fstat(fd_, &st) != 0)
+		{
+			const int error = errno;
+			close();
+			throw std::system_error(error, std::generic_category(), path);
+		}
+		size_ = static_cast<std::size_t>(st.st_size);
+#endif
+	}
+
+	mappable_file(const mappable_file&) = delete;
+	mappable_file& operator =(const mappable_file&) = delete;
+
+	~mappable_file()
+	{
+		close();
+	}
+
+	//! returns file size.
+	byte_count size() const noexcept
+	{
+		return byte_count(size_);
+	}
+
+	//! maps the whole file.
+	template <typename T>
+	mapped_file<T> map() const
+	{
+		return map_bytes<T>(0, size_);
+	}
+
+	//! maps a window of count elements starting at offset.
+	//!
+	//! The window is clipped at the end of the file.
+	template <typename T, typename Rep, typename Policy>
+	mapped_file<T> map_range(count_of<T, Rep, Policy> offset, detail::type_identity_t<count_of<T>> count) const
+	{
+		const std::size_t begin = offset.to_size() < size_ / sizeof(T) ? offset.to_size() * sizeof(T) : size_;
+		const std::size_t rest = size_ - begin;
+		const std::size_t bytes = count.to_size() < rest / sizeof(T) ? count.to_size() * sizeof(T) : rest;
+		return map_bytes<T>(begin, bytes);
+	}
+
+private:
+	//! mapping offsets must be aligned to this.
+	static std::size_t map_granularity() noexcept
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		::GetSystemInfo(&info);
+		return info.dwAllocationGranularity;
+#else
+		return os_page_count(1).to_byte_count();
+#endif
+	}
+
+	template <typename T>
+	mapped_file<T> map_bytes(std::size_t begin, std::size_t bytes) const
+	{
+		const std::size_t elems = bytes / sizeof(T);
+		if (elems == 0)
+		{
+			return {};
+		}
+
+		const std::size_t aligned_begin = begin & ~(map_granularity() - 1);
+		const std::size_t length = begin - aligned_begin + elems * sizeof(T);
+#if defined(_WIN32)
+		const auto offset = static_cast<std::uint64_t>(aligned_begin);
+		void* base = ::MapViewOfFile(mapping_, FILE_MAP_READ, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), length);
+		if (!base)
+		{
+			throw std::system_error(static_cast<int>(::GetLastError()), std::system_category(), "MapViewOfFile");
+		}
+#else
+		void* base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd_, static_cast<off_t>(aligned_begin));
+		if (base == MAP_FAILED)
+		{
+			throw std::system_error(errno, std::generic_category(), "mmap");
+		}
+#endif
+		auto first = reinterpret_cast<const T*>(static_cast<const unsigned char*>(base) + (begin - aligned_begin));
+		return { base, length, { first, count_of<T>(elems) } };
+	}
+
+	void close() noexcept
+	{
+#if defined(_WIN32)
+		if (mapping_)
+		{
+			::CloseHandle(mapping_);
+			mapping_ = nullptr;
+		}
+		if (file_ != INVALID_HANDLE_VALUE)
+		{
+			::CloseHandle(file_);
+			file_ = INVALID_HANDLE_VALUE;
+		}
+#else
+		if (fd_ >= 0)
+		{
+			::close(fd_);
+			fd_ = -1;
+		}
+#endif
+	}
+};
+
+//! maps a whole file read-only.
+//!
+//! Throws std::system_error if the file can't be opened or mapped.
+template <typename T>
+mapped_file<T> map_file(const char* path)
+{
+	return mappable_file(path).map<T>();
+}
+
+//! @}
+
+}
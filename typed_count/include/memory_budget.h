@@ -0,0 +1,210 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "typed_count_core.h"
+#include "atomic_count.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Lock-free memory quota
+//!
+//! memory_budget limits the bytes reserved against it. The limit and the reservations can be
+//! given in any unit and are converted to bytes. try_reserve() fails instead of exceeding
+//! the limit, so an over-budget allocation fails fast without a lock.
+//! A budget can have a parent, like a tenant budget under a process budget. A reservation
+//! must fit in the budget and all of its ancestors. The parent must outlive its children.
+//! typed_arena and pooled_buffer can allocate against a budget.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! memory_budget process{ 8_gb };
+//! memory_budget tenant{ 512_mb, &process };
+//! if (!tenant.try_reserve(request.size()))
+//! {
+//!     return reject_over_quota();
+//! }
+//! ...
+//! tenant.release(request.size());
+//! @endcode
+class memory_budget
+{
+	std::atomic<std::size_t> limit_;
+	atomic_count_of<std::byte> used_;
+	memory_budget* parent_;
+
+public:
+	//! ctor. limit can be given in any unit like 512_mb.
+	template <typename Unit>
+	explicit memory_budget(count_of<Unit> limit, memory_budget* parent = nullptr) noexcept
+		: limit_(limit.to_byte_count()), parent_(parent)
+	{}
+
+	memory_budget(const memory_budget&) = delete;
+	memory_budget& operator =(const memory_budget&) = delete;
+
+	//! reserves amount if it fits in this budget and all of its ancestors.
+	//!
+	//! Returns false without reserving anything otherwise.
+	template <typename T, typename Rep, typename Policy>
+	bool try_reserve(count_of<T, Rep, Policy> amount) noexcept
+	{
+		return try_reserve_bytes(amount.template to_count_of<std::byte>());
+	}
+
+	//! releases amount reserved by try_reserve().
+	template <typename T, typename Rep, typename Policy>
+	void release(count_of<T, Rep, Policy> amount) noexcept
+	{
+		const byte_count bytes = amount.template to_count_of<std::byte>();
+		for (memory_budget* budget = this; budget; budget = budget->parent_)
+		{
+			assert(budget->used_.load(std::memory_order_relaxed) >= bytes);
+			budget->used_.fetch_sub(bytes, std::memory_order_relaxed);
+		}
+	}
+
+	//! returns bytes reserved.
+	byte_count used() const noexcept
+	{
+		return used_.load(std::memory_order_relaxed);
+	}
+
+	//! returns limit.
+	byte_count limit() const noexcept
+	{
+		return byte_count(limit_.load(std::memory_order_relaxed));
+	}
+
+	//! returns bytes which can still be reserved from this budget ignoring its ancestors.
+	byte_count available() const noexcept
+	{
+		const std::size_t limit = limit_.load(std::memory_order_relaxed);
+		const std::size_t used = used_.load(std::memory_order_relaxed).to_size();
+		return byte_count(used < limit ? limit - used : 0);
+	}
+
+	//! changes limit. Lowering it below used() only makes further reservations fail.
+	template <typename Unit>
+	void set_limit(count_of<Unit> limit) noexcept
+	{
+		limit_.store(limit.to_byte_count(), std::memory_order_relaxed);
+	}
+
+	memory_budget* parent() const noexcept
+	{
+		return parent_;
+	}
+
+private:
+	bool try_reserve_bytes(byte_count bytes) noexcept
+	{
+		byte_count used = used_.load(std::memory_order_relaxed);
+		do
+		{
+			const std::size_t limit = limit_.load(std::memory_order_relaxed);
+			if (bytes.to_size() > limit || used.to_size() > limit - bytes.to_size())
+			{
+				return false;
+			}
+		} while (!used_.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+
+		if (parent_ && !parent_->try_reserve_bytes(bytes))
+		{
+			used_.fetch_sub(bytes, std::memory_order_relaxed);
+			return false;
+		}
+		return true;
+	}
+};
+
+//! Per-thread cache of reservations from a memory_budget
+//!
+//! Reserves from the budget in batches of quantum and serves try_reserve() and release()
+//! from its local credit, so threads allocating small amounts don't contend on the budget.
+//! The cached credit counts as used in the budget. Credit above twice the quantum is given
+//! back, and the rest is given back on destruction.
+//! It is not thread-safe. Make it thread_local or keep it in per-thread state.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! thread_local budget_cache cache{ tenant, 1_mb };
+//! if (cache.try_reserve(byte_count(size))) { ... cache.release(byte_count(size)); }
+//! @endcode
+class budget_cache
+{
+	memory_budget& budget_;
+	std::size_t quantum_;
+	std::size_t credit_ = 0;
+
+public:
+	//! ctor. quantum can be given in any unit like 1_mb.
+	template <typename Unit>
+	budget_cache(memory_budget& budget, count_of<Unit> quantum) noexcept
+		: budget_(budget), quantum_(quantum.to_byte_count())
+	{}
+
+	budget_cache(const budget_cache&) = delete;
+	budget_cache& operator =(const budget_cache&) = delete;
+
+	~budget_cache()
+	{
+		budget_.release(byte_count(credit_));
+	}
+
+	//! reserves amount from the local credit, refilling it from the budget if needed.
+	template <typename T, typename Rep, typename Policy>
+	bool try_reserve(count_of<T, Rep, Policy> amount) noexcept
+	{
+		const std::size_t bytes = amount.template to_count_of<std::byte>().to_size();
+		if (bytes > credit_)
+		{
+			// Prefetches a quantum beyond what is missing. Falls back to the exact amount near the limit.
+			const std::size_t missing = bytes - credit_;
+			const std::size_t batch = missing <= SIZE_MAX - quantum_ ? missing + quantum_ : missing;
+			if (budget_.try_reserve(byte_count(batch)))
+			{
+				credit_ += batch;
+			}
+			else if (budget_.try_reserve(byte_count(missing)))
+			{
+				credit_ += missing;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		credit_ -= bytes;
+		return true;
+	}
+
+	//! releases amount to the local credit.
+	template <typename T, typename Rep, typename Policy>
+	void release(count_of<T, Rep, Policy> amount) noexcept
+	{
+		credit_ += amount.template to_count_of<std::byte>().to_size();
+		if (credit_ > quantum_ * 2)
+		{
+			budget_.release(byte_count(credit_ - quantum_));
+			credit_ = quantum_;
+		}
+	}
+
+	//! returns bytes reserved from the budget but not handed out.
+	byte_count credit() const noexcept
+	{
+		return byte_count(credit_);
+	}
+};
+
+//! @}
+
+}
@@ -0,0 +1,151 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+//! @addtogroup utilities
+//! @{
+
+//! TYPED_COUNT_NUMA enables NUMA placement by libnuma when 1. The program must link -lnuma.
+//!
+//! The default 0 makes numa_resource allocate from the heap without placing the memory.
+#ifndef TYPED_COUNT_NUMA
+#define TYPED_COUNT_NUMA 0
+#endif
+
+//! @}
+
+#if TYPED_COUNT_NUMA
+#include <numa.h>
+#endif
+
+#include "typed_count_core.h"
+#include "resource_array.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Memory resource which places memory on a NUMA node
+//!
+//! numa_resource(node) binds memory to a node by numa_alloc_onnode(), so buffers scanned by
+//! threads of that node are local to them. interleaved() spreads the pages of each
+//! allocation across all nodes by numa_alloc_interleaved(), which suits large tables shared
+//! by all nodes. Each allocation maps whole pages, so use it for large arrays rather than
+//! for many small ones, or put a typed_arena in front of it.
+//! Without TYPED_COUNT_NUMA or if the system has no NUMA support, memory comes from the
+//! heap and available() is false.
+//! Alignments above the page size throw std::bad_alloc. numa_resource is thread-safe.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! numa_resource local{ 1 };
+//! auto rows = make_safe_array_for_overwrite(count_of<row>(n), &local);	// freed back to local
+//! auto shared = numa_resource::interleaved();
+//! auto index = make_unique_safe_array(count_of<std::uint64_t>(1 << 28), &shared);
+//! @endcode
+class numa_resource : public std::pmr::memory_resource
+{
+	static constexpr int interleave_node = -1;
+
+	int node_;
+
+	struct interleave_tag
+	{};
+
+	explicit numa_resource(interleave_tag) noexcept
+		: node_(interleave_node)
+	{}
+
+public:
+	//! binds allocations to node, 0 to node_count() - 1.
+	explicit numa_resource(int node) noexcept
+		: node_(node)
+	{}
+
+	//! returns a resource which interleaves the pages of allocations across all nodes.
+	static numa_resource interleaved() noexcept
+	{
+		return numa_resource(interleave_tag());
+	}
+
+	//! true if allocations are placed on nodes.
+	static bool available() noexcept
+	{
+#if TYPED_COUNT_NUMA
+		static const bool numa = ::numa_available() >= 0;
+		return numa;
+#else
+		return false;
+#endif
+	}
+
+	//! returns the number of configured nodes, which is 1 unless available().
+	static int node_count() noexcept
+	{
+#if TYPED_COUNT_NUMA
+		return available() ? ::numa_num_configured_nodes() : 1;
+#else
+		return 1;
+#endif
+	}
+
+	//! returns the node allocations are bound to, or -1 if they are interleaved.
+	int node() const noexcept
+	{
+		return node_;
+	}
+
+	bool is_interleaved() const noexcept
+	{
+		return node_ == interleave_node;
+	}
+
+protected:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override
+	{
+#if TYPED_COUNT_NUMA
+		if (available())
+		{
+			if (alignment > static_cast<std::size_t>(::numa_pagesize()))
+			{
+				throw std::bad_alloc();
+			}
+			// libnuma maps at least one page even for 0 bytes.
+			void* p = is_interleaved() ? ::numa_alloc_interleaved(bytes ? bytes : 1) : ::numa_alloc_onnode(bytes ? bytes : 1, node_);
+			if (!p)
+			{
+				throw std::bad_alloc();
+			}
+			return p;
+		}
+#endif
+		return ::operator new(bytes, std::align_val_t(alignment));
+	}
+
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept override
+	{
+#if TYPED_COUNT_NUMA
+		if (available())
+		{
+			::numa_free(p, bytes ? bytes : 1);
+			return;
+		}
+#endif
+		(void)bytes;
+		::operator delete(p, std::align_val_t(alignment));
+	}
+
+	//! memory of any numa_resource can be freed by any other one.
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return dynamic_cast<const numa_resource*>(&other) != nullptr;
+	}
+};
+
+//! @}
+
+}
@@ -0,0 +1,152 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup unit_traits
+//! Units whose size depends on the machine. Their sizes are queried once at the first use.
+//! @{
+
+//! empty OsPage type for the base page size of the OS like 4KB or 64KB.
+struct OsPage {};
+
+//! empty HugePage type for the default huge page size like 2MB.
+struct HugePage {};
+
+//! empty GiganticPage type for the largest huge page size like 1GB.
+struct GiganticPage {};
+
+namespace detail
+{
+
+inline std::size_t query_os_page_size() noexcept
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	::GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	const long size = ::sysconf(_SC_PAGESIZE);
+	return size > 0 ? static_cast<std::size_t>(size) : 4096;
+#endif
+}
+
+inline std::size_t query_huge_page_size() noexcept
+{
+	const std::size_t fallback = std::size_t(2) * 1024 * 1024;
+#if defined(_WIN32)
+	const SIZE_T size = ::GetLargePageMinimum();
+	return size ? size : fallback;
+#elif defined(__linux__)
+	std::size_t size = 0;
+	if (FILE* meminfo = std::fopen("/proc/meminfo", "r"))
+	{
+		char line[128];
+		while (std::fgets(line, sizeof(line), meminfo))
+		{
+			if (std::strncmp(line, "Hugepagesize:", 13) == 0)
+			{
+				size = std::strtoull(line + 13, nullptr, 10) * 1024;
+				break;
+			}
+		}
+		std::fclose(meminfo);
+	}
+	return size ? size : fallback;
+#else
+	return fallback;
+#endif
+}
+
+inline std::size_t query_gigantic_page_size() noexcept
+{
+	const std::size_t fallback = std::size_t(1024) * 1024 * 1024;
+#if defined(__linux__)
+	// Each supported huge page size has a hugepages-<size>kB directory.
+	std::size_t size = 0;
+	if (DIR* dir = ::opendir("/sys/kernel/mm/hugepages"))
+	{
+		while (const dirent* entry = ::readdir(dir))
+		{
+			if (std::strncmp(entry->d_name, "hugepages-", 10) == 0)
+			{
+				const std::size_t kb = std::strtoull(entry->d_name + 10, nullptr, 10);
+				size = kb * 1024 > size ? kb * 1024 : size;
+			}
+		}
+		::closedir(dir);
+	}
+	return size ? size : fallback;
+#else
+	// Windows has no separate gigantic page size.
+	return fallback;
+#endif
+}
+
+}
+
+//! OsPage unit traits.
+template <>
+struct unit_traits<OsPage>
+{
+	//! base page size of the OS in bytes.
+	static std::size_t runtime_size() noexcept
+	{
+		static const std::size_t size = detail::query_os_page_size();
+		return size;
+	}
+};
+
+//! HugePage unit traits.
+template <>
+struct unit_traits<HugePage>
+{
+	//! default huge page size in bytes. 2MB if it can't be queried.
+	static std::size_t runtime_size() noexcept
+	{
+		static const std::size_t size = detail::query_huge_page_size();
+		return size;
+	}
+};
+
+//! GiganticPage unit traits.
+template <>
+struct unit_traits<GiganticPage>
+{
+	//! largest huge page size in bytes. 1GB if it can't be queried.
+	static std::size_t runtime_size() noexcept
+	{
+		static const std::size_t size = detail::query_gigantic_page_size();
+		return size;
+	}
+};
+
+//! @}
+
+//! @addtogroup typedefs
+//! @{
+
+using os_page_count = count_of<OsPage>;
+using huge_page_count = count_of<HugePage>;
+using gigantic_page_count = count_of<GiganticPage>;
+
+//! @}
+
+}
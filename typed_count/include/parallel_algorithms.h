@@ -0,0 +1,154 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "typed_count_core.h"
+#include "thread_pool.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! default grain of the parallel algorithms.
+//!
+//! A chunk of 128KB stays in the L2 cache of a core with the output of a transform.
+constexpr kb_count default_parallel_grain = kb_count(128);
+
+namespace detail
+{
+
+//! converts a grain in any unit to whole elements of T. A grain is at least one element.
+template <typename T, typename Grain, typename Rep, typename Policy>
+std::size_t grain_elements(count_of<Grain, Rep, Policy> grain) noexcept
+{
+	const std::size_t elements = grain.template to_count_of<std::remove_cv_t<T>>().to_size();
+	return elements ? elements : 1;
+}
+
+//! calls fn(offset, length) for every grain of size elements on a pool.
+template <typename F>
+void for_each_grain(thread_pool& pool, std::size_t size, std::size_t grain, F&& fn)
+{
+	const std::size_t chunks = size / grain + (size % grain != 0);
+	pool.run(chunks, [&](std::size_t chunk)
+	{
+		const std::size_t offset = chunk * grain;
+		fn(offset, size - offset < grain ? size - offset : grain);
+	});
+}
+
+}
+
+//! calls fn(chunk) for consecutive chunks of data in parallel.
+//!
+//! Chunks are zero-copy slices of grain, except the last one which may be shorter. grain is
+//! either a count of elements like count_of<T>(4096) or a working set like 256_kb, which gives
+//! chunks of the same size in bytes for any element type.
+//! fn is called concurrently from several threads. Throws the first exception thrown by fn.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! parallel_for_chunks(records, [&](safe_array<record> chunk) { compact(chunk); }, 1_mb);
+//! @endcode
+template <typename T, typename Check, typename F, typename Grain = Kb, typename Rep = std::size_t, typename Policy = wrap_policy>
+void parallel_for_chunks(safe_array<T, Check> data, F fn, count_of<Grain, Rep, Policy> grain = default_parallel_grain,
+	thread_pool& pool = thread_pool::shared())
+{
+	using count_t = count_of<std::remove_cv_t<T>>;
+	detail::for_each_grain(pool, data.count().to_size(), detail::grain_elements<T>(grain), [&](std::size_t offset, std::size_t length)
+	{
+		fn(data.subarray(count_t(offset), count_t(length)));
+	});
+}
+
+//! calls fn(element) for all elements of data in parallel.
+//!
+//! See parallel_for_chunks() for grain.
+template <typename T, typename Check, typename F, typename Grain = Kb, typename Rep = std::size_t, typename Policy = wrap_policy>
+void parallel_for_each(safe_array<T, Check> data, F fn, count_of<Grain, Rep, Policy> grain = default_parallel_grain,
+	thread_pool& pool = thread_pool::shared())
+{
+	parallel_for_chunks(data, [&](safe_array<T, Check> chunk)
+	{
+		for (T& element : chunk)
+		{
+			fn(element);
+		}
+	}, grain, pool);
+}
+
+//! stores fn(in[i]) to out[i] for all elements of in in parallel and returns the part of out written.
+//!
+//! out must have at least as many elements as in, which is checked by its check policy.
+//! grain applies to in. See parallel_for_chunks() for grain.
+template <typename T, typename Check, typename U, typename UCheck, typename F, typename Grain = Kb, typename Rep = std::size_t, typename Policy = wrap_policy>
+safe_array<U, UCheck> parallel_transform(safe_array<T, Check> in, safe_array<U, UCheck> out, F fn,
+	count_of<Grain, Rep, Policy> grain = default_parallel_grain, thread_pool& pool = thread_pool::shared())
+{
+	const safe_array<U, UCheck> written = out.first(count_of<std::remove_cv_t<U>>(in.count().to_size()));
+	detail::for_each_grain(pool, in.count().to_size(), detail::grain_elements<T>(grain), [&](std::size_t offset, std::size_t length)
+	{
+		T* source = in.data() + offset;
+		U* destination = written.data() + offset;
+		for (std::size_t i = 0; i < length; ++i)
+		{
+			destination[i] = fn(source[i]);
+		}
+	});
+	return written;
+}
+
+//! reduces transform(element) of all elements of data with init by reduce in parallel.
+//!
+//! Like std::transform_reduce(), reduce must be associative and accept R and the result of
+//! transform in any order. Chunk results are combined in order, so reduce needn't be commutative.
+//! See parallel_for_chunks() for grain.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! std::uint64_t sum = parallel_transform_reduce(bytes, std::uint64_t(0), std::plus<>(),
+//!     [](std::byte b) { return std::to_integer<std::uint64_t>(b); });
+//! @endcode
+template <typename T, typename Check, typename R, typename Reduce, typename Transform, typename Grain = Kb, typename Rep = std::size_t, typename Policy = wrap_policy>
+R parallel_transform_reduce(safe_array<T, Check> data, R init, Reduce reduce, Transform transform,
+	count_of<Grain, Rep, Policy> grain = default_parallel_grain, thread_pool& pool = thread_pool::shared())
+{
+	const std::size_t size = data.count().to_size();
+	const std::size_t elements = detail::grain_elements<T>(grain);
+	std::vector<std::optional<R>> partials(size / elements + (size % elements != 0));
+	detail::for_each_grain(pool, size, elements, [&](std::size_t offset, std::size_t length)
+	{
+		T* p = data.data() + offset;
+		R partial(transform(p[0]));
+		for (std::size_t i = 1; i < length; ++i)
+		{
+			partial = reduce(std::move(partial), transform(p[i]));
+		}
+		partials[offset / elements].emplace(std::move(partial));
+	});
+	for (auto& partial : partials)
+	{
+		init = reduce(std::move(init), std::move(*partial));
+	}
+	return init;
+}
+
+//! reduces all elements of data with init by reduce in parallel.
+//!
+//! Like std::reduce(), reduce must be associative and accept R and T in any order.
+//! See parallel_transform_reduce().
+template <typename T, typename Check, typename R, typename Reduce, typename Grain = Kb, typename Rep = std::size_t, typename Policy = wrap_policy>
+R parallel_reduce(safe_array<T, Check> data, R init, Reduce reduce, count_of<Grain, Rep, Policy> grain = default_parallel_grain,
+	thread_pool& pool = thread_pool::shared())
+{
+	return parallel_transform_reduce(data, std::move(init), reduce, [](T& element) -> T& { return element; }, grain, pool);
+}
+
+//! @}
+
+}
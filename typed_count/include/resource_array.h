@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+#include "typed_count_core.h"
+#include "aligned_array.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Deleter of unique_resource_safe_array which destroys the elements and returns the memory
+//! to the resource the array was allocated from.
+template <typename T>
+struct resource_array_delete
+{
+	std::pmr::memory_resource* resource = std::pmr::new_delete_resource();
+
+	void operator()(safe_array<T> array) const noexcept
+	{
+		std::destroy_n(array.data(), array.count().to_size());
+		resource->deallocate(array.data(), array.count().to_byte_count(), alignof(T));
+	}
+};
+
+//! owning safe array allocated from a memory resource.
+template <typename T>
+using unique_resource_safe_array = unique_safe_array<T, resource_array_delete<T>>;
+
+namespace detail
+{
+
+//! allocates count elements from resource and constructs them by construct.
+template <typename T, typename Rep, typename Policy, typename Construct>
+T* allocate_from_resource(count_of<T, Rep, Policy> count, std::pmr::memory_resource* resource, Construct construct)
+{
+	auto p = static_cast<T*>(resource->allocate(checked_byte_count(count), alignof(T)));
+	try
+	{
+		construct(p, count.to_size());
+	}
+	catch (...)
+	{
+		resource->deallocate(p, count.to_byte_count(), alignof(T));
+		throw;
+	}
+	return p;
+}
+
+}
+
+//! allocates a value-initialized safe array from a memory resource.
+//!
+//! The resource can be a typed_arena, a numa_resource or any std::pmr::memory_resource.
+//! Delete the array by delete_safe_array() with the same resource, or use
+//! make_unique_safe_array() with a resource which does it automatically.
+//! Throws std::bad_alloc if the resource can't allocate the memory.
+template <typename T, typename Rep, typename Policy>
+safe_array<T> make_safe_array(count_of<T, Rep, Policy> count, std::pmr::memory_resource* resource)
+{
+	return { detail::allocate_from_resource(count, resource, [](T* p, std::size_t n) { std::uninitialized_value_construct_n(p, n); }), count };
+}
+
+//! destroys an array allocated by make_safe_array() from resource and deallocates it.
+template <typename T>
+void delete_safe_array(safe_array<T> array, std::pmr::memory_resource* resource) noexcept
+{
+	resource_array_delete<T>{ resource }(array);
+}
+
+//! allocates a value-initialized owning safe array from a memory resource.
+//!
+//! The array is returned to the resource when it goes out of scope. The resource must
+//! outlive the array.
+//! Throws std::bad_alloc if the resource can't allocate the memory.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! typed_arena arena{ 16_pg };
+//! auto ids = make_unique_safe_array(count_of<std::uint32_t>(256), &arena);
+//! @endcode
+template <typename T, typename Rep, typename Policy>
+unique_resource_safe_array<T> make_unique_safe_array(count_of<T, Rep, Policy> count, std::pmr::memory_resource* resource)
+{
+	return unique_resource_safe_array<T>(make_safe_array(count, resource), resource_array_delete<T>{ resource });
+}
+
+//! allocates a default-initialized owning safe array from a memory resource.
+//!
+//! Elements of trivial types are left uninitialized, so pages of a resource which maps
+//! memory aren't touched until they are written. That is what places them on a NUMA node
+//! under the first-touch policy.
+template <typename T, typename Rep, typename Policy>
+unique_resource_safe_array<T> make_safe_array_for_overwrite(count_of<T, Rep, Policy> count, std::pmr::memory_resource* resource)
+{
+	T* p = detail::allocate_from_resource(count, resource, [](T* p, std::size_t n) { std::uninitialized_default_construct_n(p, n); });
+	return unique_resource_safe_array<T>({ p, count }, resource_array_delete<T>{ resource });
+}
+
+//! @}
+
+}
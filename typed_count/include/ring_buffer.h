@@ -0,0 +1,312 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#include "typed_count_core.h"
+#include "atomic_count.h"
+
+namespace typed_count
+{
+
+namespace detail
+{
+
+//! Element storage of a ring, which copies runs in and out with at most two memcpy calls.
+template <typename T>
+class ring_storage
+{
+	static_assert(std::is_trivially_copyable_v<T>, "rings copy elements by memcpy");
+
+	unique_safe_array<T> elems_;
+	std::size_t mask_;
+
+public:
+	//! allocates capacity elements rounded up to a power of two.
+	explicit ring_storage(count_of<T> capacity)
+	{
+		std::size_t size = 1;
+		while (size < capacity.to_size())
+		{
+			size <<= 1;
+		}
+		elems_ = make_safe_array_for_overwrite(count_of<T>(size));
+		mask_ = size - 1;
+	}
+
+	std::size_t capacity() const noexcept
+	{
+		return mask_ + 1;
+	}
+
+	//! copies n elements of src to the ring starting at index position.
+	void copy_in(std::size_t position, const T* src, std::size_t n) const noexcept
+	{
+		const std::size_t offset = position & mask_;
+		const std::size_t first = n < capacity() - offset ? n : capacity() - offset;
+		std::memcpy(elems_.data() + offset, src, first * sizeof(T));
+		if (first < n)
+		{
+			std::memcpy(elems_.data(), src + first, (n - first) * sizeof(T));
+		}
+	}
+
+	//! copies n elements of the ring starting at index position to dst.
+	void copy_out(std::size_t position, T* dst, std::size_t n) const noexcept
+	{
+		const std::size_t offset = position & mask_;
+		const std::size_t first = n < capacity() - offset ? n : capacity() - offset;
+		std::memcpy(dst, elems_.data() + offset, first * sizeof(T));
+		if (first < n)
+		{
+			std::memcpy(dst + first, elems_.data(), (n - first) * sizeof(T));
+		}
+	}
+};
+
+}
+
+//! @addtogroup utilities
+//! @{
+
+//! Lock-free single-producer single-consumer ring of T
+//!
+//! Capacity is a count_of<T> rounded up to a power of two. Batch operations take and return
+//! typed counts of elements, so a byte count can't be passed for a count of records, and copy
+//! a batch with at most two memcpy calls. The producer and the consumer indexes are on
+//! separate cache lines, and each side caches the index of the other side so that it reads
+//! the shared one only when the ring looks full or empty.
+//! T must be trivially copyable. One thread may push and another one may pop concurrently.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! spsc_ring<char> ring{ 64_kb .to_count_of<char>() };
+//! // I/O thread
+//! char_count pushed = ring.try_push_n(safe_array<const char>(received, len));
+//! // parser thread
+//! fixed_size_array<char, 4096> batch;
+//! char_count popped = ring.try_pop_n(safe_array<char>(batch));
+//! @endcode
+template <typename T>
+class spsc_ring
+{
+	struct alignas(detail::cache_line_size) producer_side
+	{
+		std::atomic<std::size_t> tail{ 0 };
+		std::size_t cached_head = 0;
+	};
+
+	struct alignas(detail::cache_line_size) consumer_side
+	{
+		std::atomic<std::size_t> head{ 0 };
+		std::size_t cached_tail = 0;
+	};
+
+	detail::ring_storage<T> storage_;
+	producer_side producer_;
+	consumer_side consumer_;
+
+public:
+	//! ctor. Throws std::bad_alloc if the elements can't be allocated.
+	explicit spsc_ring(count_of<T> capacity)
+		: storage_(capacity)
+	{}
+
+	spsc_ring(const spsc_ring&) = delete;
+	spsc_ring& operator =(const spsc_ring&) = delete;
+
+	//! pushes as many elements of src as fit and returns the count pushed. Producer only.
+	count_of<T> try_push_n(safe_array<const T> src) noexcept
+	{
+		const std::size_t tail = producer_.tail.load(std::memory_order_relaxed);
+		std::size_t free = storage_.capacity() - (tail - producer_.cached_head);
+		if (free < src.count().to_size())
+		{
+			producer_.cached_head = consumer_.head.load(std::memory_order_acquire);
+			free = storage_.capacity() - (tail - producer_.cached_head);
+		}
+		const std::size_t n = src.count().to_size() < free ? src.count().to_size() : free;
+		if (n)
+		{
+			storage_.copy_in(tail, src.data(), n);
+			producer_.tail.store(tail + n, std::memory_order_release);
+		}
+		return count_of<T>(n);
+	}
+
+	//! pushes an element if the ring isn't full. Producer only.
+	bool try_push(const T& value) noexcept
+	{
+		return try_push_n({ &value, 1 }) == count_of<T>(1);
+	}
+
+	//! pops up to dst.count() elements to dst and returns the count popped. Consumer only.
+	count_of<T> try_pop_n(safe_array<T> dst) noexcept
+	{
+		const std::size_t head = consumer_.head.load(std::memory_order_relaxed);
+		std::size_t ready = consumer_.cached_tail - head;
+		if (ready < dst.count().to_size())
+		{
+			consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+			ready = consumer_.cached_tail - head;
+		}
+		const std::size_t n = dst.count().to_size() < ready ? dst.count().to_size() : ready;
+		if (n)
+		{
+			storage_.copy_out(head, dst.data(), n);
+			consumer_.head.store(head + n, std::memory_order_release);
+		}
+		return count_of<T>(n);
+	}
+
+	//! pops an element if the ring isn't empty. Consumer only.
+	bool try_pop(T& value) noexcept
+	{
+		return try_pop_n({ &value, 1 }) == count_of<T>(1);
+	}
+
+	//! returns the capacity rounded up to a power of two.
+	count_of<T> capacity() const noexcept
+	{
+		return count_of<T>(storage_.capacity());
+	}
+
+	//! returns elements in the ring. It is exact only while neither side is active.
+	count_of<T> size() const noexcept
+	{
+		const std::size_t head = consumer_.head.load(std::memory_order_acquire);
+		return count_of<T>(producer_.tail.load(std::memory_order_acquire) - head);
+	}
+
+	bool empty() const noexcept
+	{
+		return size() == count_of<T>(0);
+	}
+};
+
+//! Multi-producer single-consumer ring of T
+//!
+//! Like spsc_ring but any number of threads may push. A producer reserves a run of slots by
+//! a compare-and-swap, copies its batch into them without a lock and then publishes each
+//! slot by storing its sequence number. The consumer pops published slots up to the first
+//! one still being copied, so a preempted producer delays only the consumer's view of its
+//! own slots and never blocks other producers. A batch is pushed to contiguous slots and
+//! isn't interleaved with other batches, but it may be popped in parts.
+//! T must be trivially copyable. One thread may pop concurrently with the producers.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! mpsc_ring<log_record> records{ count_of<log_record>(1024) };
+//! records.try_push(record);					// from any thread
+//! fixed_size_array<log_record, 64> batch;
+//! auto n = records.try_pop_n(safe_array<log_record>(batch));	// from the writer thread
+//! @endcode
+template <typename T>
+class mpsc_ring
+{
+	struct alignas(detail::cache_line_size) index
+	{
+		std::atomic<std::size_t> value{ 0 };
+	};
+
+	detail::ring_storage<T> storage_;
+	//! position + 1 of the element last published in each slot.
+	std::unique_ptr<std::atomic<std::size_t>[]> published_;
+	index reserved_;	//!< end of the slots reserved by producers.
+	index head_;		//!< first slot not popped yet.
+
+public:
+	//! ctor. Throws std::bad_alloc if the elements can't be allocated.
+	explicit mpsc_ring(count_of<T> capacity)
+		: storage_(capacity)
+		, published_(new std::atomic<std::size_t>[storage_.capacity()])
+	{
+		for (std::size_t i = 0; i < storage_.capacity(); ++i)
+		{
+			published_[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	mpsc_ring(const mpsc_ring&) = delete;
+	mpsc_ring& operator =(const mpsc_ring&) = delete;
+
+	//! pushes as many elements of src as fit as one batch and returns the count pushed.
+	count_of<T> try_push_n(safe_array<const T> src) noexcept
+	{
+		std::size_t start = reserved_.value.load(std::memory_order_relaxed);
+		std::size_t n;
+		do
+		{
+			const std::size_t free = storage_.capacity() - (start - head_.value.load(std::memory_order_acquire));
+			n = src.count().to_size() < free ? src.count().to_size() : free;
+			if (!n)
+			{
+				return count_of<T>(0);
+			}
+		} while (!reserved_.value.compare_exchange_weak(start, start + n, std::memory_order_relaxed));
+
+		storage_.copy_in(start, src.data(), n);
+		for (std::size_t position = start; position != start + n; ++position)
+		{
+			published_[position & (storage_.capacity() - 1)].store(position + 1, std::memory_order_release);
+		}
+		return count_of<T>(n);
+	}
+
+	//! pushes an element if the ring isn't full.
+	bool try_push(const T& value) noexcept
+	{
+		return try_push_n({ &value, 1 }) == count_of<T>(1);
+	}
+
+	//! pops up to dst.count() published elements to dst and returns the count popped. Consumer only.
+	//!
+	//! Stops at the first slot which is reserved but not published yet.
+	count_of<T> try_pop_n(safe_array<T> dst) noexcept
+	{
+		const std::size_t head = head_.value.load(std::memory_order_relaxed);
+		std::size_t n = 0;
+		while (n < dst.count().to_size()
+			&& published_[(head + n) & (storage_.capacity() - 1)].load(std::memory_order_acquire) == head + n + 1)
+		{
+			++n;
+		}
+		if (n)
+		{
+			storage_.copy_out(head, dst.data(), n);
+			head_.value.store(head + n, std::memory_order_release);
+		}
+		return count_of<T>(n);
+	}
+
+	//! pops an element if one is published. Consumer only.
+	bool try_pop(T& value) noexcept
+	{
+		return try_pop_n({ &value, 1 }) == count_of<T>(1);
+	}
+
+	//! returns the capacity rounded up to a power of two.
+	count_of<T> capacity() const noexcept
+	{
+		return count_of<T>(storage_.capacity());
+	}
+
+	//! returns reserved elements in the ring. It is exact only while no thread is active.
+	count_of<T> size() const noexcept
+	{
+		const std::size_t head = head_.value.load(std::memory_order_acquire);
+		return count_of<T>(reserved_.value.load(std::memory_order_acquire) - head);
+	}
+
+	bool empty() const noexcept
+	{
+		return size() == count_of<T>(0);
+	}
+};
+
+//! @}
+
+}
@@ -0,0 +1,169 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Temporary buffer on the stack or the heap
+//!
+//! small_buffer<T, InlineCount> holds up to InlineCount elements in a fixed_size_array inside
+//! itself, so a local buffer of a small count doesn't allocate. A larger count spills to
+//! a memory resource, which is the heap by default and could be a typed_arena. Unlike
+//! alloca_array(), a data-dependent count can't overflow the stack.
+//! The default InlineCount fits 4KB. Other thresholds are counts of elements, so
+//! small_buffer<wchar_t, 260> holds MAX_PATH wchar_t.
+//! Elements are default-initialized, so trivial ones are left uninitialized. Inline storage
+//! always constructs InlineCount elements.
+//! small_buffer can't be copied or moved. Use it through its safe_array view.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! const wchar_count len = str_len_s(pwsz) + 1_wch;
+//! small_buffer<wchar_t> wbuf{ len };		// inline up to 2048 wchar_t on Windows
+//! str_cpy_s(pwsz, wbuf.data(), len);
+//! small_buffer<char> scratch{ 64_kb .to_count_of<char>(), &arena };	// spills to a typed_arena
+//! @endcode
+template <typename T, std::size_t InlineCount = (sizeof(T) < 4096 ? 4096 / sizeof(T) : 1)>
+class small_buffer
+{
+	static_assert(!std::is_const_v<T>);
+	static_assert(InlineCount > 0);
+
+	using count_t = count_of<T>;
+
+	fixed_size_array<T, InlineCount> inline_;
+	safe_array<T> array_;
+	std::pmr::memory_resource* resource_;
+
+public:
+	//! holds count elements. Spills to resource if count exceeds InlineCount.
+	//!
+	//! Throws std::bad_alloc if the resource can't allocate.
+	explicit small_buffer(count_t count, std::pmr::memory_resource* resource = std::pmr::new_delete_resource())
+		: resource_(resource)
+	{
+		if (count <= inline_count())
+		{
+			array_ = { inline_.elems, count };
+			return;
+		}
+
+		const std::size_t bytes = count.to_byte_count();
+		T* p = static_cast<T*>(resource_->allocate(bytes, alignof(T)));
+		try
+		{
+			std::uninitialized_default_construct_n(p, count.to_size());
+		}
+		catch (...)
+		{
+			resource_->deallocate(p, bytes, alignof(T));
+			throw;
+		}
+		array_ = { p, count };
+	}
+
+	small_buffer(const small_buffer&) = delete;
+	small_buffer& operator =(const small_buffer&) = delete;
+
+	~small_buffer()
+	{
+		if (!is_inline())
+		{
+			std::destroy_n(array_.data(), array_.count().to_size());
+			resource_->deallocate(array_.data(), array_.count().to_byte_count(), alignof(T));
+		}
+	}
+
+	//! returns the maximum count held without allocating.
+	static constexpr count_t inline_count() noexcept
+	{
+		return count_t(InlineCount);
+	}
+
+	//! true if the elements are in the inline storage.
+	bool is_inline() const noexcept
+	{
+		return array_.data() == inline_.elems;
+	}
+
+	//! returns a view of the elements.
+	safe_array<T> get() noexcept
+	{
+		return array_;
+	}
+
+	//! returns a read-only view of the elements.
+	safe_array<const T> get() const noexcept
+	{
+		return array_;
+	}
+
+	operator safe_array<T>() noexcept
+	{
+		return array_;
+	}
+
+	operator safe_array<const T>() const noexcept
+	{
+		return array_;
+	}
+
+	T& operator[](count_t idx)
+	{
+		return array_[idx];
+	}
+
+	const T& operator[](count_t idx) const
+	{
+		return array_[idx];
+	}
+
+	count_t count() const noexcept
+	{
+		return array_.count();
+	}
+
+	T* data() noexcept
+	{
+		return array_.data();
+	}
+
+	const T* data() const noexcept
+	{
+		return array_.data();
+	}
+
+	T* begin() noexcept
+	{
+		return array_.begin();
+	}
+
+	const T* begin() const noexcept
+	{
+		return array_.begin();
+	}
+
+	T* end() noexcept
+	{
+		return array_.end();
+	}
+
+	const T* end() const noexcept
+	{
+		return array_.end();
+	}
+};
+
+//! @}
+
+}
@@ -0,0 +1,317 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "typed_count_core.h"
+#include "atomic_count.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Work-stealing thread pool for fork-join loops
+//!
+//! run() calls a function for every chunk index of a range and returns when all calls are done.
+//! A thread running a range keeps splitting it in halves, queues the upper halves in its own
+//! deque and runs the lowest chunk. Idle workers steal the oldest, and so largest, halves from
+//! the other deques. Chunks move to another thread only when it is idle, and a thread tends to
+//! run neighbouring chunks.
+//! The calling thread runs chunks too until its range is done, so run() can be nested.
+//! A pool without workers runs everything on the calling thread.
+//! run() rethrows the first exception thrown by a chunk. Chunks not started by then are skipped.
+//! Parallel algorithms over safe arrays are in parallel_algorithms.h.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! thread_pool pool{ 3 };
+//! pool.run(blocks.size(), [&](std::size_t block) { checksums[block] = crc32(blocks[block]); });
+//! @endcode
+class thread_pool
+{
+	//! a range of chunks run by one call to run().
+	struct region
+	{
+		void (*run_chunk)(void* fn, std::size_t chunk);
+		void* fn;
+		std::atomic<std::size_t> remaining;
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+
+		region(void (*run_chunk)(void*, std::size_t), void* fn, std::size_t chunks) noexcept
+			: run_chunk(run_chunk), fn(fn), remaining(chunks)
+		{}
+	};
+
+	//! chunks [begin, end) of a region.
+	struct job
+	{
+		region* owner;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	struct alignas(detail::cache_line_size) queue
+	{
+		std::mutex mutex;
+		std::deque<job> jobs;
+	};
+
+	//! worker and queue of the current thread.
+	struct worker_context
+	{
+		const thread_pool* pool = nullptr;
+		std::size_t queue = 0;
+	};
+
+	std::vector<std::thread> workers_;
+	std::unique_ptr<queue[]> queues_;	//!< one per worker and the last one for other threads.
+	std::size_t queue_count_;
+	std::atomic<std::size_t> queued_{ 0 };
+	std::atomic<std::size_t> sleeping_{ 0 };
+	std::mutex sleep_mutex_;
+	std::condition_variable wake_;
+	bool stop_ = false;
+
+public:
+	//! starts workers. The calling thread of run() works as well, so the default is one
+	//! worker less than the hardware threads.
+	explicit thread_pool(std::size_t workers = default_workers())
+		: queues_(std::make_unique<queue[]>(workers + 1)), queue_count_(workers + 1)
+	{
+		workers_.reserve(workers);
+		try
+		{
+			for (std::size_t i = 0; i < workers; ++i)
+			{
+				workers_.emplace_back([this, i] { work(i); });
+			}
+		}
+		catch (...)
+		{
+			shutdown();
+			throw;
+		}
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator =(const thread_pool&) = delete;
+
+	~thread_pool()
+	{
+		shutdown();
+	}
+
+	//! returns the pool shared by the parallel algorithms by default.
+	static thread_pool& shared()
+	{
+		static thread_pool pool;
+		return pool;
+	}
+
+	//! returns one less than the hardware threads, or 0 if they are unknown.
+	static std::size_t default_workers() noexcept
+	{
+		const unsigned threads = std::thread::hardware_concurrency();
+		return threads > 1 ? threads - 1 : 0;
+	}
+
+	//! returns number of worker threads.
+	std::size_t workers() const noexcept
+	{
+		return workers_.size();
+	}
+
+	//! calls fn(chunk) for every chunk in [0, chunks) and waits until all calls are done.
+	//!
+	//! fn is called concurrently from several threads.
+	template <typename F>
+	void run(std::size_t chunks, F&& fn)
+	{
+		if (chunks <= 1 || workers_.empty())
+		{
+			for (std::size_t chunk = 0; chunk < chunks; ++chunk)
+			{
+				fn(chunk);
+			}
+			return;
+		}
+
+		using fn_t = std::remove_reference_t<F>;
+		region r([](void* f, std::size_t chunk) { (*static_cast<fn_t*>(f))(chunk); },
+			const_cast<void*>(static_cast<const void*>(std::addressof(fn))), chunks);
+		const std::size_t self = current_queue();
+		push(self, { &r, 0, chunks });
+
+		// Helps until the last chunk of this range is done. Chunks of other ranges may be run meanwhile.
+		while (r.remaining.load(std::memory_order_acquire) != 0)
+		{
+			job j;
+			if (pop(self, j) || steal(self, j))
+			{
+				execute(j, self);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+		if (r.error)
+		{
+			std::rethrow_exception(r.error);
+		}
+	}
+
+private:
+	static worker_context& current() noexcept
+	{
+		thread_local worker_context context;
+		return context;
+	}
+
+	std::size_t current_queue() const noexcept
+	{
+		const worker_context& context = current();
+		return context.pool == this ? context.queue : queue_count_ - 1;
+	}
+
+	void push(std::size_t self, const job& j)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queues_[self].mutex);
+			queues_[self].jobs.push_back(j);
+		}
+		queued_.fetch_add(1);
+		if (sleeping_.load() != 0)
+		{
+			// Taking the lock orders the wakeup after a worker checked queued_ or started waiting.
+			{
+				std::lock_guard<std::mutex> lock(sleep_mutex_);
+			}
+			wake_.notify_one();
+		}
+	}
+
+	//! pops the newest job of the own queue.
+	bool pop(std::size_t self, job& j) noexcept
+	{
+		queue& q = queues_[self];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.jobs.empty())
+		{
+			return false;
+		}
+		j = q.jobs.back();
+		q.jobs.pop_back();
+		queued_.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	//! steals the oldest job of another queue.
+	bool steal(std::size_t self, job& j) noexcept
+	{
+		for (std::size_t i = 1; i < queue_count_; ++i)
+		{
+			queue& q = queues_[(self + i) % queue_count_];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if (!q.jobs.empty())
+			{
+				j = q.jobs.front();
+				q.jobs.pop_front();
+				queued_.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//! splits a job until it has one chunk and runs the chunks left.
+	void execute(job j, std::size_t self) noexcept
+	{
+		region& r = *j.owner;
+		try
+		{
+			while (j.end - j.begin > 1)
+			{
+				const std::size_t middle = j.begin + (j.end - j.begin) / 2;
+				push(self, { &r, middle, j.end });
+				j.end = middle;
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			// Runs the rest of the job here if it can't be queued.
+		}
+
+		for (std::size_t chunk = j.begin; chunk < j.end; ++chunk)
+		{
+			if (!r.failed.load(std::memory_order_relaxed))
+			{
+				try
+				{
+					r.run_chunk(r.fn, chunk);
+				}
+				catch (...)
+				{
+					if (!r.failed.exchange(true))
+					{
+						r.error = std::current_exception();
+					}
+				}
+			}
+			// The region may be gone once the count reaches 0.
+			r.remaining.fetch_sub(1, std::memory_order_acq_rel);
+		}
+	}
+
+	void work(std::size_t self)
+	{
+		current() = { this, self };
+		for (;;)
+		{
+			job j;
+			if (pop(self, j) || steal(self, j))
+			{
+				execute(j, self);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleep_mutex_);
+			sleeping_.fetch_add(1);
+			wake_.wait(lock, [this] { return stop_ || queued_.load() != 0; });
+			sleeping_.fetch_sub(1);
+			if (stop_)
+			{
+				return;
+			}
+		}
+	}
+
+	void shutdown() noexcept
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (auto& worker : workers_)
+		{
+			worker.join();
+		}
+		workers_.clear();
+	}
+};
+
+//! @}
+
+}
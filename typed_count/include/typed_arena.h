@@ -0,0 +1,262 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+#include "typed_count_core.h"
+#include "memory_budget.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Bump-pointer arena allocator
+//!
+//! typed_arena reserves chunks whose size is given in any unit like page_count or mb_count
+//! and hands out safe arrays from them by bumping a pointer, aligned for the element type.
+//! Individual arrays are never freed. reset() frees everything at once.
+//! It is also a std::pmr::memory_resource, so standard containers can share it.
+//! Chunks can be reserved against a memory_budget so that an arena over its budget throws
+//! std::bad_alloc instead of growing.
+//! typed_arena is not thread-safe.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! typed_arena arena{ 16_pg };
+//! safe_array<wchar_t> wbuf = arena.allocate(32_wch);
+//! std::pmr::vector<int> ints{ &arena };
+//! arena.reset();				// wbuf and ints' storage are gone.
+//! @endcode
+class typed_arena : public std::pmr::memory_resource
+{
+	//! header at the beginning of each chunk.
+	struct chunk
+	{
+		chunk* next;
+		std::size_t size;	//!< chunk size in bytes including this header.
+	};
+
+	std::size_t chunk_size_;
+	chunk* chunks_ = nullptr;
+	std::uintptr_t cur_ = 0;
+	std::uintptr_t end_ = 0;
+	std::size_t allocated_ = 0;
+	memory_budget* budget_ = nullptr;
+
+public:
+	//! default chunk size.
+	static constexpr kb_count default_chunk_size{ 64 };
+
+	//! default ctor.
+	typed_arena() noexcept
+		: typed_arena(default_chunk_size)
+	{}
+
+	//! ctor.
+	//!
+	//! chunk_size can be given in any unit like 16_pg or 1_mb.
+	//! Allocations larger than a chunk get a dedicated chunk.
+	template <typename Unit>
+	explicit typed_arena(count_of<Unit> chunk_size) noexcept
+		: chunk_size_(chunk_size.to_byte_count() > sizeof(chunk) ? chunk_size.to_byte_count() : sizeof(chunk) * 2)
+	{}
+
+	//! ctor with a budget which chunks are reserved against.
+	//!
+	//! The budget must outlive the arena.
+	template <typename Unit>
+	typed_arena(count_of<Unit> chunk_size, memory_budget& budget) noexcept
+		: typed_arena(chunk_size)
+	{
+		budget_ = &budget;
+	}
+
+	typed_arena(const typed_arena&) = delete;
+	typed_arena& operator =(const typed_arena&) = delete;
+
+	~typed_arena() override
+	{
+		release();
+	}
+
+	using std::pmr::memory_resource::allocate;
+
+	//! allocates a default-initialized array of T.
+	//!
+	//! T must be trivially destructible since the arena never runs destructors.
+	//! Throws std::bad_alloc if a new chunk can't be allocated or exceeds the budget.
+	template <typename T, typename Rep, typename Policy>
+	safe_array<T> allocate(count_of<T, Rep, Policy> count)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "typed_arena never runs destructors");
+
+		auto p = static_cast<T*>(allocate_bytes(count.to_byte_count(), alignof(T)));
+		std::uninitialized_default_construct_n(p, count.to_size());
+		return { p, count };
+	}
+
+	//! frees all arrays at once.
+	//!
+	//! The first chunk of the regular size is kept and reused, so an arena which is reset
+	//! after each request doesn't go back to the heap in a steady state.
+	void reset() noexcept
+	{
+		chunk* kept = nullptr;
+		for (chunk* c = chunks_; c;)
+		{
+			chunk* next = c->next;
+			if (!kept && c->size == chunk_size_)
+			{
+				kept = c;
+				kept->next = nullptr;
+			}
+			else
+			{
+				delete_chunk(c);
+			}
+			c = next;
+		}
+
+		chunks_ = kept;
+		cur_ = kept ? reinterpret_cast<std::uintptr_t>(kept + 1) : 0;
+		end_ = kept ? reinterpret_cast<std::uintptr_t>(kept) + kept->size : 0;
+		allocated_ = 0;
+	}
+
+	//! frees all arrays and returns all chunks to the heap.
+	void release() noexcept
+	{
+		for (chunk* c = chunks_; c;)
+		{
+			chunk* next = c->next;
+			delete_chunk(c);
+			c = next;
+		}
+
+		chunks_ = nullptr;
+		cur_ = end_ = 0;
+		allocated_ = 0;
+	}
+
+	//! returns byte count handed out since the last reset() excluding alignment padding.
+	byte_count allocated() const noexcept
+	{
+		return byte_count(allocated_);
+	}
+
+	//! returns chunk size.
+	byte_count chunk_size() const noexcept
+	{
+		return byte_count(chunk_size_);
+	}
+
+protected:
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override
+	{
+		return allocate_bytes(bytes, alignment);
+	}
+
+	//! individual deallocation is a no-op. Memory is freed by reset() or release().
+	void do_deallocate(void*, std::size_t, std::size_t) noexcept override
+	{}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	static std::uintptr_t align_up(std::uintptr_t p, std::size_t alignment) noexcept
+	{
+		return (p + alignment - 1) & ~std::uintptr_t(alignment - 1);
+	}
+
+	void* allocate_bytes(std::size_t bytes, std::size_t alignment)
+	{
+		const std::uintptr_t p = align_up(cur_, alignment);
+		if (cur_ && p <= end_ && end_ - p >= bytes)
+		{
+			cur_ = p + bytes;
+			allocated_ += bytes;
+			return reinterpret_cast<void*>(p);
+		}
+		return allocate_slow(bytes, alignment);
+	}
+
+	chunk* new_chunk(std::size_t size)
+	{
+		if (budget_ && !budget_->try_reserve(byte_count(size)))
+		{
+			throw std::bad_alloc();
+		}
+		chunk* c;
+		try
+		{
+			c = static_cast<chunk*>(::operator new(size));
+		}
+		catch (...)
+		{
+			if (budget_)
+			{
+				budget_->release(byte_count(size));
+			}
+			throw;
+		}
+		c->size = size;
+		return c;
+	}
+
+	void delete_chunk(chunk* c) noexcept
+	{
+		if (budget_)
+		{
+			budget_->release(byte_count(c->size));
+		}
+		::operator delete(c);
+	}
+
+	void* allocate_slow(std::size_t bytes, std::size_t alignment)
+	{
+		const std::size_t slack = alignment > alignof(std::max_align_t) ? alignment - 1 : 0;
+		const std::size_t needed = sizeof(chunk) + bytes + slack;
+		if (needed < bytes)
+		{
+			throw std::bad_alloc();
+		}
+
+		if (needed > chunk_size_)
+		{
+			// A dedicated chunk. Keeps serving the rest of the current chunk.
+			chunk* c = new_chunk(needed);
+			if (chunks_)
+			{
+				c->next = chunks_->next;
+				chunks_->next = c;
+			}
+			else
+			{
+				c->next = nullptr;
+				chunks_ = c;
+			}
+			allocated_ += bytes;
+			return reinterpret_cast<void*>(align_up(reinterpret_cast<std::uintptr_t>(c + 1), alignment));
+		}
+
+		chunk* c = new_chunk(chunk_size_);
+		c->next = chunks_;
+		chunks_ = c;
+		cur_ = reinterpret_cast<std::uintptr_t>(c + 1);
+		end_ = reinterpret_cast<std::uintptr_t>(c) + chunk_size_;
+		return allocate_bytes(bytes, alignment);
+	}
+};
+
+//! @}
+
+}
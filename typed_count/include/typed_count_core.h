@@ -0,0 +1,2059 @@
+﻿#include <cstring>
+#include <cwchar>
+#include <cerrno>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <limits>
+#include <stdexcept>
+#include <ratio>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+#include "typed_count_simd.h"
+
+#pragma once
+
+//! Provides type-safe count of various units like char, wchar, Page,
+//! Kb, Mb, Gb, Tb, an etc.
+//!
+//! <h4>Motivation</h4>
+//! We need to count various units like count of bytes, count of wchars, count of buffers,
+//! count of pages, and etc. But they are all expressed as any integral type and
+//! C++ type system does not block us converting an integral type to another integral type
+//! like casting unsigned long to int and passing count of one unit to the parameter
+//! for count of the other unit. So, there are chances that someone makes mistakes.
+//! This library provides a template class which can represent count of any unit but provides type safety
+//! for count of different units.
+//!
+//! <h4>Usage examples</h4>
+//! @include typed_count.cpp
+namespace typed_count
+{
+
+//! @defgroup unit_traits Unit traits
+//! Defines traits of units such as Page,
+//! All unit traits must provide unit size in bytes as a compile-time std::ratio.
+//! @{
+
+//! Helper base for unit traits of a unit whose size is Num/Den bytes.
+//!
+//! The ratio is reduced by GCD at compile time.
+//! size::value is the unit size rounded up to whole bytes and is kept for code written
+//! before unit traits were expressed as a ratio.
+template <std::intmax_t Num, std::intmax_t Den = 1>
+struct unit_size_ratio
+{
+	static_assert(Num > 0 && Den > 0);
+
+	//! unit size in bytes.
+	using ratio = typename std::ratio<Num, Den>::type;
+
+	//! unit size in whole bytes.
+	enum size : std::size_t
+	{
+		value = static_cast<std::size_t>((Num + Den - 1) / Den)	//!< unit size in byte(s).
+	};
+};
+
+//! Default unit traits for a type.
+//!
+//! It uses sizeof() and so the complete type must be visible.
+//! If the real size of a unit is different from type definition,
+//! need to define a separate unit_traits using template specialization.
+//!
+//! Usage:
+//! @code{.cpp}
+//! using unit_size = unit_traits<Unit>::ratio;	// std::ratio<bytes per unit>
+//! @endcode
+template <typename T>
+struct unit_traits : unit_size_ratio<sizeof(T)>
+{};
+
+//! empty Page type for Page unit traits.
+//!
+//! Page is a fixed 8KB page like a database page. Use OsPage for the page size of the OS.
+struct Page {};
+
+//! Page unit traits.
+template <>
+struct unit_traits<Page> : unit_size_ratio<8 * 1024>			//!< 8KB page.
+{};
+
+//! empty Kb type for Kb unit.
+struct Kb {};
+
+//! Kb unit traits.
+template <>
+struct unit_traits<Kb> : unit_size_ratio<1024>					//!< 1KB == 1024 bytes.
+{};
+
+//! empty Mb type for Mb unit.
+struct Mb {};
+
+//! Mb unit traits.
+template <>
+struct unit_traits<Mb> : unit_size_ratio<1024 * 1024>			//!< 1MB == 1024KB.
+{};
+
+//! empty Gb type for Gb unit.
+struct Gb {};
+
+//! Gb unit traits.
+template <>
+struct unit_traits<Gb> : unit_size_ratio<1024 * 1024 * 1024>		//!< 1GB == 1024MB.
+{};
+
+//! empty Tb type for Tb unit.
+struct Tb {};
+
+//! Tb unit traits.
+template <>
+struct unit_traits<Tb> : unit_size_ratio<std::intmax_t(1024) * 1024 * 1024 * 1024>	//!< 1TB == 1024GB.
+{};
+
+//! empty bit type for bit unit.
+//!
+//! Counts of bytes convert to bits exactly. Counts of bits convert to bytes truncated like
+//! any other conversion to a larger unit. Use ceil_count_of() to round them up.
+struct bit {};
+
+//! bit unit traits.
+template <>
+struct unit_traits<bit> : unit_size_ratio<1, 8>					//!< 8 bits == 1 byte.
+{};
+
+namespace detail
+{
+
+//! unit ratio of traits which only provide size::value.
+template <typename Traits, typename = void>
+struct unit_ratio_of
+{
+	using type = std::ratio<static_cast<std::intmax_t>(Traits::size::value)>;
+};
+
+//! unit ratio of traits which provide ratio.
+template <typename Traits>
+struct unit_ratio_of<Traits, std::void_t<typename Traits::ratio>>
+{
+	using type = typename Traits::ratio::type;
+};
+
+}
+
+namespace detail
+{
+
+//! unit traits whose size is only known at runtime provide static runtime_size().
+template <typename Traits, typename = void>
+struct is_runtime_unit : std::false_type
+{};
+
+template <typename Traits>
+struct is_runtime_unit<Traits, std::void_t<decltype(Traits::runtime_size())>> : std::true_type
+{};
+
+}
+
+//! true if the size of unit T is only known at runtime like the page size of the OS.
+//!
+//! unit_traits of such a unit provide static std::size_t runtime_size() returning the unit
+//! size in bytes instead of ratio. Conversions from or to them are computed at runtime.
+template <typename T>
+inline constexpr bool is_runtime_unit_v = detail::is_runtime_unit<unit_traits<T>>::value;
+
+//! unit size of T in bytes as std::ratio.
+//!
+//! Accepts user-defined unit_traits which only provide size::value.
+template <typename T>
+using unit_ratio_t = typename detail::unit_ratio_of<unit_traits<T>>::type;
+
+namespace detail
+{
+
+//! unit size in bytes as a fraction evaluated at runtime.
+struct runtime_ratio
+{
+	std::size_t num;
+	std::size_t den;
+};
+
+template <typename T>
+runtime_ratio unit_runtime_ratio() noexcept
+{
+	if constexpr (is_runtime_unit_v<T>)
+	{
+		return { unit_traits<T>::runtime_size(), 1 };
+	}
+	else
+	{
+		using ratio_t = unit_ratio_t<T>;
+		return { static_cast<std::size_t>(ratio_t::num), static_cast<std::size_t>(ratio_t::den) };
+	}
+}
+
+constexpr bool is_power_of_two(std::size_t value) noexcept
+{
+	return value != 0 && (value & (value - 1)) == 0;
+}
+
+//! true if T is a runtime unit or has a positive compile-time size.
+template <typename T>
+constexpr bool is_valid_unit() noexcept
+{
+	if constexpr (is_runtime_unit_v<T>)
+	{
+		return true;
+	}
+	else
+	{
+		return unit_ratio_t<T>::num > 0;
+	}
+}
+
+}
+
+//! ratio to convert a count of From to a count of To, reduced by GCD.
+template <typename From, typename To>
+using unit_conversion_t = std::ratio_divide<unit_ratio_t<From>, unit_ratio_t<To>>;
+
+namespace detail
+{
+
+//! true if every value of the count representation From fits in To.
+template <typename From, typename To>
+inline constexpr bool is_widening_rep_v = std::numeric_limits<From>::max() <= std::numeric_limits<To>::max();
+
+//! the wider of two count representations.
+template <typename A, typename B>
+using wider_rep_t = std::conditional_t<(sizeof(A) >= sizeof(B)), A, B>;
+
+//! true if any count in Rep scaled by Num/Den fits in Candidate.
+template <typename Rep, typename Candidate, std::uintmax_t Num, std::uintmax_t Den>
+constexpr bool scaled_rep_fits() noexcept
+{
+	constexpr std::uintmax_t max_rep = std::numeric_limits<Rep>::max();
+	constexpr std::uintmax_t max_candidate = std::numeric_limits<Candidate>::max();
+	return Num <= Den ? max_rep <= max_candidate : max_rep <= max_candidate / Num * Den;
+}
+
+//! the narrowest of Rep, std::uint32_t and std::size_t which holds any count in Rep scaled by Num/Den.
+//!
+//! Falls back to std::size_t whose conversions wrap around as before.
+template <typename Rep, std::uintmax_t Num, std::uintmax_t Den>
+using scaled_rep_t = std::conditional_t<scaled_rep_fits<Rep, Rep, Num, Den>(), Rep,
+	std::conditional_t<(sizeof(std::uint32_t) > sizeof(Rep)) && scaled_rep_fits<Rep, std::uint32_t, Num, Den>(), std::uint32_t, std::size_t>>;
+
+}
+
+//! @}
+
+//! @defgroup overflow_policies Overflow policies
+//! Policies for count_of arithmetic and conversions which don't fit in the representation.
+//!
+//! A policy provides static add(), sub(), mul() and shl() for any unsigned Rep, narrow<Rep>()
+//! from size_t, and nothrow which is false if they may throw.
+//! @{
+
+namespace detail
+{
+
+template <typename Rep>
+constexpr bool add_overflow(Rep a, Rep b, Rep& result) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_add_overflow(a, b, &result);
+#else
+	result = static_cast<Rep>(a + b);
+	return result < a;
+#endif
+}
+
+template <typename Rep>
+constexpr bool sub_overflow(Rep a, Rep b, Rep& result) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_sub_overflow(a, b, &result);
+#else
+	result = static_cast<Rep>(a - b);
+	return b > a;
+#endif
+}
+
+template <typename Rep>
+constexpr bool mul_overflow(Rep a, Rep b, Rep& result) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_mul_overflow(a, b, &result);
+#else
+	result = static_cast<Rep>(a * b);
+	return a != 0 && result / a != b;
+#endif
+}
+
+template <typename Rep>
+constexpr bool shl_overflow(Rep a, unsigned shift, Rep& result) noexcept
+{
+	constexpr unsigned bits = std::numeric_limits<Rep>::digits;
+	result = shift < bits ? static_cast<Rep>(a << shift) : Rep(0);
+	return a != 0 && (shift >= bits || a > static_cast<Rep>(std::numeric_limits<Rep>::max() >> shift));
+}
+
+}
+
+//! Wraps around like unsigned arithmetic. The default policy.
+//!
+//! Generates the same code as plain size_t arithmetic.
+struct wrap_policy
+{
+	static constexpr bool nothrow = true;
+
+	template <typename Rep>
+	static constexpr Rep add(Rep a, Rep b) noexcept
+	{
+		return static_cast<Rep>(a + b);
+	}
+
+	template <typename Rep>
+	static constexpr Rep sub(Rep a, Rep b) noexcept
+	{
+		return static_cast<Rep>(a - b);
+	}
+
+	template <typename Rep>
+	static constexpr Rep mul(Rep a, Rep b) noexcept
+	{
+		return static_cast<Rep>(a * b);
+	}
+
+	template <typename Rep>
+	static constexpr Rep shl(Rep a, unsigned shift) noexcept
+	{
+		return static_cast<Rep>(a << shift);
+	}
+
+	//! the value must fit in Rep.
+	template <typename Rep>
+	static constexpr Rep narrow(std::size_t value) noexcept
+	{
+		assert(static_cast<std::size_t>(static_cast<Rep>(value)) == value);
+		return static_cast<Rep>(value);
+	}
+};
+
+//! Throws std::overflow_error if a result doesn't fit in Rep.
+//!
+//! Each check is a single overflow flag test.
+struct checked_policy
+{
+	static constexpr bool nothrow = false;
+
+	template <typename Rep>
+	static constexpr Rep add(Rep a, Rep b)
+	{
+		Rep result{};
+		if (detail::add_overflow(a, b, result))
+		{
+			throw std::overflow_error("count_of overflow");
+		}
+		return result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep sub(Rep a, Rep b)
+	{
+		Rep result{};
+		if (detail::sub_overflow(a, b, result))
+		{
+			throw std::overflow_error("count_of underflow");
+		}
+		return result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep mul(Rep a, Rep b)
+	{
+		Rep result{};
+		if (detail::mul_overflow(a, b, result))
+		{
+			throw std::overflow_error("count_of overflow");
+		}
+		return result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep shl(Rep a, unsigned shift)
+	{
+		Rep result{};
+		if (detail::shl_overflow(a, shift, result))
+		{
+			throw std::overflow_error("count_of overflow");
+		}
+		return result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep narrow(std::size_t value)
+	{
+		if (value > std::numeric_limits<Rep>::max())
+		{
+			throw std::overflow_error("count_of narrowing overflow");
+		}
+		return static_cast<Rep>(value);
+	}
+};
+
+//! Clamps a result which doesn't fit in Rep to 0 or the maximum of Rep.
+struct saturating_policy
+{
+	static constexpr bool nothrow = true;
+
+	template <typename Rep>
+	static constexpr Rep add(Rep a, Rep b) noexcept
+	{
+		Rep result{};
+		return detail::add_overflow(a, b, result) ? std::numeric_limits<Rep>::max() : result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep sub(Rep a, Rep b) noexcept
+	{
+		Rep result{};
+		return detail::sub_overflow(a, b, result) ? Rep(0) : result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep mul(Rep a, Rep b) noexcept
+	{
+		Rep result{};
+		return detail::mul_overflow(a, b, result) ? std::numeric_limits<Rep>::max() : result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep shl(Rep a, unsigned shift) noexcept
+	{
+		Rep result{};
+		return detail::shl_overflow(a, shift, result) ? std::numeric_limits<Rep>::max() : result;
+	}
+
+	template <typename Rep>
+	static constexpr Rep narrow(std::size_t value) noexcept
+	{
+		return value > std::numeric_limits<Rep>::max() ? std::numeric_limits<Rep>::max() : static_cast<Rep>(value);
+	}
+};
+
+namespace detail
+{
+
+//! policy of the result of an operation on counts with two policies. Any non-wrap policy wins.
+template <typename LPolicy, typename RPolicy>
+using combined_policy_t = std::conditional_t<std::is_same_v<LPolicy, wrap_policy>, RPolicy, LPolicy>;
+
+}
+
+//! @}
+
+//! @defgroup core_classes Core classes
+//! Core classes to provide type-safe unit count.
+//! @{
+
+//! A holder of count value.
+//!
+//! An implementation class to store count value in Rep. Arithmetic goes through Policy.
+template <typename Rep = std::size_t, typename Policy = wrap_policy>
+class count_holder
+{
+public:
+	//! ctor.
+	constexpr count_holder(Rep count) noexcept
+		: count_(count)
+	{}
+
+	//! copy ctor.
+	//!
+	//! Must stay defaulted. A user-provided copy ctor makes count_of<T> non-trivially copyable
+	//! and forces it to be passed by a hidden reference instead of in a register.
+	constexpr count_holder(const count_holder& other) noexcept = default;
+
+	//! copy assignment operator.
+	//!
+	//! Must stay defaulted for the same reason as the copy ctor.
+	constexpr count_holder& operator =(const count_holder& other) noexcept = default;
+
+	//! supports += operator.
+	constexpr count_holder& operator +=(const count_holder& other) noexcept(Policy::nothrow)
+	{
+		count_ = Policy::add(count_, other.count_);
+		return *this;
+	}
+
+	//! supports -= operator.
+	constexpr count_holder& operator -=(const count_holder& other) noexcept(Policy::nothrow)
+	{
+		count_ = Policy::sub(count_, other.count_);
+		return *this;
+	}
+
+	//! supports prefix ++ operator.
+	constexpr count_holder& operator ++() noexcept(Policy::nothrow)
+	{
+		count_ = Policy::add(count_, Rep(1));
+		return *this;
+	}
+
+	//! supports postfix ++ operator.
+	constexpr count_holder operator ++(int) noexcept(Policy::nothrow)
+	{
+		count_holder r(*this);
+		++*this;
+		return r;
+	}
+
+	//! supports prefix -- operator.
+	constexpr count_holder& operator --() noexcept(Policy::nothrow)
+	{
+		count_ = Policy::sub(count_, Rep(1));
+		return *this;
+	}
+
+	//! supports postfix -- operator.
+	constexpr count_holder operator --(int) noexcept(Policy::nothrow)
+	{
+		count_holder r(*this);
+		--*this;
+		return r;
+	}
+
+	//! Converts count in one unit to count in the other unit.
+	//!
+	//! Num/Den is a compile-time ratio already reduced by GCD. So, identity conversions
+	//! are no-ops and power-of-two ratios are lowered to shifts.
+	//! Quotient and remainder are scaled separately, so the intermediate never overflows
+	//! unless the result itself doesn't fit in size_t, in which case Policy decides.
+	//! The default policy wraps around just like any other unsigned arithmetic.
+	//! The result is computed in size_t and returned as Result.
+	template <typename Result, std::uintmax_t Num, std::uintmax_t Den>
+	constexpr Result convert() const noexcept(Policy::nothrow)
+	{
+		static_assert(Num > 0 && Den > 0);
+		static_assert(Num <= SIZE_MAX / Den, "conversion ratio is too large for size_t");
+
+		constexpr auto num = static_cast<std::size_t>(Num);
+		constexpr auto den = static_cast<std::size_t>(Den);
+		const std::size_t count = count_;
+		if constexpr (num == 1 && den == 1)
+		{
+			return static_cast<Result>(count);
+		}
+		else if constexpr (den == 1)
+		{
+			return static_cast<Result>(Policy::mul(count, num));
+		}
+		else if constexpr (num == 1)
+		{
+			return static_cast<Result>(count / den);
+		}
+		else
+		{
+			return static_cast<Result>(Policy::add(Policy::mul(count / den, num), count % den * num / den));
+		}
+	}
+
+	//! Converts count in one unit to count in the other unit at runtime.
+	//!
+	//! For units whose size is only known at runtime. Power-of-two ratios are shifts.
+	//! Otherwise quotient and remainder are scaled separately like the compile-time version.
+	//! Divider can't be 0. So, no exception will be thrown unless Policy throws.
+	std::size_t convert(std::size_t multiplier, std::size_t divider) const noexcept(Policy::nothrow)
+	{
+		const std::size_t count = count_;
+		if (detail::is_power_of_two(multiplier) && detail::is_power_of_two(divider))
+		{
+			const unsigned mul_shift = detail::count_trailing_zeros(multiplier);
+			const unsigned div_shift = detail::count_trailing_zeros(divider);
+			return mul_shift >= div_shift ? Policy::shl(count, mul_shift - div_shift) : count >> (div_shift - mul_shift);
+		}
+		return Policy::add(Policy::mul(count / divider, multiplier), count % divider * multiplier / divider);
+	}
+
+	//! cast to Rep.
+	constexpr Rep count() const noexcept
+	{
+		return count_;
+	}
+
+private:
+	Rep count_;
+};
+
+//! type-safe count of any unit.
+//!
+//! type requirement: unit_traits<T> must be defined and > 0.
+//! Rep is the unsigned integer type storing the count and defaults to size_t. A narrower Rep
+//! like count32_of<char> halves the footprint of large arrays of lengths.
+//! Conversions to a wider Rep are implicit. Conversions to a narrower Rep are explicit and
+//! asserted. narrow_count_s() checks them at runtime.
+//! Policy decides what happens when arithmetic or a conversion overflows. The default
+//! wrap_policy wraps around. checked_count_of<T> throws std::overflow_error and
+//! saturating_count_of<T> clamps. Counts with different policies convert implicitly,
+//! so a checked count can be passed where count_of<T> is expected. Function templates which
+//! deduce T from a count take count_of<T, Rep, Policy>, so they accept counts of any Rep and Policy.
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! fixed_size_array<const char, 5> name{"ABCD"};
+//! auto pNameCopy = make_safe_array(str_len_s(name) + 1_ch);
+//! for (auto i = 0_ch; i < pNameCopy.count() && name[i] != '\0'; ++i)
+//! {
+//!     pNameCopy[i] = name[i];
+//! }
+//! @endcode
+template <typename T, typename Rep = std::size_t, typename Policy = wrap_policy>
+class count_of : private count_holder<Rep, Policy>
+{
+	using holder_t = count_holder<Rep, Policy>;
+	using holder_t::count;
+	using holder_t::convert;
+
+public:
+	using traits_t = T;
+	using rep_t = Rep;
+	using policy_t = Policy;
+
+	static_assert(detail::is_valid_unit<traits_t>());
+	static_assert(std::is_unsigned_v<Rep> && !std::is_same_v<Rep, bool> && sizeof(Rep) <= sizeof(std::size_t),
+		"Rep must be an unsigned integer type no wider than size_t");
+
+	//! @name ctors_casts
+	//! ctors and casts.
+	//! @{
+
+	//! default ctor.
+	constexpr count_of() noexcept
+		: holder_t(Rep(0))
+	{}
+
+	//! ctor.
+	//!
+	//! This ctor intentionally does not allow automatic conversion of size_t to count_of<T>
+	//! to provide type-safety. count must fit in Rep unless Policy checks or clamps it.
+	constexpr explicit count_of(std::size_t count) noexcept(Policy::nothrow)
+		: holder_t(Policy::template narrow<Rep>(count))
+	{}
+
+	//! default copy ctor is ok.
+	constexpr count_of(const count_of& other) noexcept = default;
+
+	//! converts a count in a narrower or the same Rep with any policy like count32_of<char> to char_count.
+	template <typename FromRep, typename FromPolicy,
+		std::enable_if_t<!(std::is_same_v<FromRep, Rep> && std::is_same_v<FromPolicy, Policy>) && detail::is_widening_rep_v<FromRep, Rep>, int> = 0>
+	constexpr count_of(const count_of<T, FromRep, FromPolicy>& other) noexcept
+		: holder_t(static_cast<Rep>(other.to_size()))
+	{}
+
+	//! converts a count in a wider Rep. The count must fit in Rep unless Policy checks or clamps it.
+	template <typename FromRep, typename FromPolicy, std::enable_if_t<!detail::is_widening_rep_v<FromRep, Rep>, int> = 0>
+	constexpr explicit count_of(const count_of<T, FromRep, FromPolicy>& other) noexcept(Policy::nothrow)
+		: count_of(other.to_size())
+	{}
+
+	//! casts to any count_of<U>.
+	//!
+	//! to support like count_of<wchar_t>::to_count_of<uint8_t>().
+	//! type requirement: unit_traits<U> must be defined and > 0.
+	//! The conversion ratio is computed at compile time unless either unit is a runtime unit.
+	//! The result Rep is the narrowest of Rep, uint32_t and size_t which holds any converted
+	//! count, so only size_t results can overflow. Runtime conversions return size_t.
+	//! The result keeps Policy.
+	template <typename U>
+	constexpr auto to_count_of() const noexcept(Policy::nothrow)
+	{
+		using to_traits_t = std::remove_cv_t<U>;
+		if constexpr (is_runtime_unit_v<traits_t> || is_runtime_unit_v<to_traits_t>)
+		{
+			const auto from = detail::unit_runtime_ratio<traits_t>();
+			const auto to = detail::unit_runtime_ratio<to_traits_t>();
+			return count_of<to_traits_t, std::size_t, Policy>(convert(from.num * to.den, from.den * to.num));
+		}
+		else
+		{
+			using ratio_t = unit_conversion_t<traits_t, to_traits_t>;
+			using to_rep_t = detail::scaled_rep_t<Rep, ratio_t::num, ratio_t::den>;
+			return count_of<to_traits_t, to_rep_t, Policy>(this->template convert<to_rep_t, ratio_t::num, ratio_t::den>());
+		}
+	}
+
+	//! casts to size_t.
+	//!
+	//! To support compatibility with existing C code or existing C++ library which requires size_t.
+	constexpr std::size_t to_size() const noexcept
+	{
+		return static_cast<std::size_t>(count());
+	}
+
+	//! casts to int.
+	//!
+	//! To support compatibility with existing C code or existing C++ library which requires int.
+	constexpr int to_int() const noexcept
+	{
+		return static_cast<int>(count());
+	}
+
+	//! casts to ulong.
+	//!
+	//! To support compatibility with existing C code or existing C++ library which requires ulong.
+	constexpr unsigned long to_ulong() const noexcept
+	{
+		return static_cast<unsigned long>(count());
+	}
+
+	//! casts to count in bytes as size_t.
+	//!
+	//! Has the same effect as to_count_of<std::byte>().to_size().
+	constexpr std::size_t to_byte_count() const noexcept(Policy::nothrow)
+	{
+		return to_count_of<std::byte>().to_size();
+	}
+
+	//! casts to count in bytes as int.
+	//!
+	//! Has the same effect as to_count_of<std::byte>().to_int().
+	constexpr int to_int_byte_count() const noexcept(Policy::nothrow)
+	{
+		return to_count_of<std::byte>().to_int();
+	}
+
+	//! casts to count in bytes as ulong.
+	//!
+	//! Has the same effect as to_count_of<std::byte>().to_ulong().
+	constexpr unsigned long to_ulong_byte_count() const noexcept(Policy::nothrow)
+	{
+		return to_count_of<std::byte>().to_ulong();
+	}
+
+	//! casts to count in wchars as size_t.
+	//!
+	//! Has the same effect as to_count_of<wchar_t>().to_ulong().
+	constexpr std::size_t to_wchar_count() const noexcept(Policy::nothrow)
+	{
+		return to_count_of<wchar_t>().to_size();
+	}
+
+	//! casts to count in wchars as int.
+	//!
+	//! Has the same effect as to_count_of<wchar_t>().to_int().
+	constexpr int to_int_wchar_count() const noexcept(Policy::nothrow)
+	{
+		return to_count_of<wchar_t>().to_int();
+	}
+
+	//! casts to count in wchars as ulong.
+	//!
+	//! Has the same effect as to_count_of<wchar_t>().to_ulong().
+	constexpr unsigned long to_ulong_wchar_count() const noexcept(Policy::nothrow)
+	{
+		return to_count_of<wchar_t>().to_ulong();
+	}
+
+	//! @}
+
+	//! @name operators
+	//! overloaded operators.
+	//! @{
+
+	//! default copy assignment is ok.
+	constexpr count_of& operator =(const count_of& other) noexcept = default;
+
+	//! supports += operator.
+	constexpr count_of& operator +=(const count_of& other) noexcept(Policy::nothrow)
+	{
+		holder_t::operator +=(other);
+		return *this;
+	}
+
+	//! supports -= operator.
+	constexpr count_of& operator -=(const count_of& other) noexcept(Policy::nothrow)
+	{
+		holder_t::operator -=(other);
+		return *this;
+	}
+
+	//! supports prefix ++ operator.
+	constexpr count_of& operator ++() noexcept(Policy::nothrow)
+	{
+		holder_t::operator ++();
+		return *this;
+	}
+
+	//! supports postfix ++ operator.
+	constexpr count_of operator ++(int) noexcept(Policy::nothrow)
+	{
+		count_of ret{ *this };
+		holder_t::operator ++(int());
+		return ret;
+	}
+
+	//! supports prefix -- operator.
+	constexpr count_of& operator --() noexcept(Policy::nothrow)
+	{
+		holder_t::operator --();
+		return *this;
+	}
+
+	//! supports postfix -- operator.
+	constexpr count_of operator --(int) noexcept(Policy::nothrow)
+	{
+		count_of ret{ *this };
+		holder_t::operator --(int());
+		return ret;
+	}
+
+	//! @}
+};
+
+//! @}
+
+//! @defgroup operators Operators
+//! overloaded non-member operators.
+//! @{
+
+//! To support operator overloading for +
+//!
+//! Counts in different Reps add up in the wider one. A checked or saturating operand makes
+//! the result checked or saturating.
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr auto operator +(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs)
+{
+	using rep_t = detail::wider_rep_t<LRep, RRep>;
+	using policy_t = detail::combined_policy_t<LPolicy, RPolicy>;
+	return count_of<T, rep_t, policy_t>(policy_t::add(static_cast<rep_t>(lhs.to_size()), static_cast<rep_t>(rhs.to_size())));
+}
+
+//! To support operator overloading for -
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr auto operator -(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs)
+{
+	using rep_t = detail::wider_rep_t<LRep, RRep>;
+	using policy_t = detail::combined_policy_t<LPolicy, RPolicy>;
+	return count_of<T, rep_t, policy_t>(policy_t::sub(static_cast<rep_t>(lhs.to_size()), static_cast<rep_t>(rhs.to_size())));
+}
+
+//! To support operator overloading for ==
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr bool operator ==(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs) noexcept
+{
+	return lhs.to_size() == rhs.to_size();
+}
+
+//! To support operator overloading for !=
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr bool operator !=(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs) noexcept
+{
+	return !(lhs == rhs);
+}
+
+//! To support operator overloading for <
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr bool operator <(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs) noexcept
+{
+	return lhs.to_size() < rhs.to_size();
+}
+
+//! To support operator overloading for <=
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr bool operator <=(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs) noexcept
+{
+	return lhs < rhs || lhs == rhs;
+}
+
+//! To support operator overloading for >
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr bool operator >(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs) noexcept
+{
+	return !(lhs <= rhs);
+}
+
+//! To support operator overloading for >=
+template <typename T, typename LRep, typename LPolicy, typename RRep, typename RPolicy>
+constexpr bool operator >=(count_of<T, LRep, LPolicy> lhs, count_of<T, RRep, RPolicy> rhs) noexcept
+{
+	return !(lhs < rhs);
+}
+
+template <typename T, typename Rep, typename Policy>
+constexpr T* operator +(T* p, count_of<T, Rep, Policy> distance) noexcept
+{
+	return p + distance.to_size();
+}
+
+template <typename T, typename Rep, typename Policy>
+constexpr T*& operator +=(T*& p, count_of<T, Rep, Policy> distance) noexcept
+{
+	p += distance.to_size();
+	return p;
+}
+
+template <typename T, typename Rep, typename Policy>
+constexpr T* operator -(T* p, count_of<T, Rep, Policy> distance) noexcept
+{
+	return p - distance.to_size();
+}
+
+template <typename T, typename Rep, typename Policy>
+constexpr T*& operator -=(T*& p, count_of<T, Rep, Policy> distance) noexcept
+{
+	p -= distance.to_size();
+	return p;
+}
+
+//! @}
+
+//! @defgroup typedefs Typedefs
+//! typedefs for common units like byte, char, wchar_t, Page, Kb, Mb, and etc.
+//! @{
+
+using byte_count = count_of<std::byte>;
+using char_count = count_of<char>;
+using wchar_count = count_of<wchar_t>;
+using page_count = count_of<Page>;
+using kb_count = count_of<Kb>;
+using mb_count = count_of<Mb>;
+using gb_count = count_of<Gb>;
+using tb_count = count_of<Tb>;
+using bit_count = count_of<bit>;
+
+//! count of T stored in 32 bits.
+template <typename T>
+using count32_of = count_of<T, std::uint32_t>;
+
+//! count of T stored in 16 bits.
+template <typename T>
+using count16_of = count_of<T, std::uint16_t>;
+
+using byte_count32 = count32_of<std::byte>;
+using char_count32 = count32_of<char>;
+using wchar_count32 = count32_of<wchar_t>;
+using page_count32 = count32_of<Page>;
+using byte_count16 = count16_of<std::byte>;
+using char_count16 = count16_of<char>;
+using wchar_count16 = count16_of<wchar_t>;
+
+//! count of T which throws std::overflow_error on overflow.
+template <typename T>
+using checked_count_of = count_of<T, std::size_t, checked_policy>;
+
+//! count of T which clamps to 0 or SIZE_MAX on overflow.
+template <typename T>
+using saturating_count_of = count_of<T, std::size_t, saturating_policy>;
+
+//! @}
+
+//! @defgroup layout_checks Layout checks
+//! Compile-time checks that typed counts and arrays stay as cheap as the raw types they wrap.
+//!
+//! count_of<T> must be trivially copyable and standard-layout with the size of size_t
+//! so that it is passed and returned in a register just like a plain size_t.
+//! @{
+
+static_assert(std::is_trivially_copyable_v<count_holder<>>);
+static_assert(std::is_standard_layout_v<count_holder<>>);
+static_assert(sizeof(count_holder<>) == sizeof(std::size_t));
+
+static_assert(std::is_trivially_copyable_v<byte_count> && std::is_standard_layout_v<byte_count>);
+static_assert(std::is_trivially_copyable_v<char_count> && std::is_standard_layout_v<char_count>);
+static_assert(std::is_trivially_copyable_v<wchar_count> && std::is_standard_layout_v<wchar_count>);
+static_assert(std::is_trivially_copyable_v<page_count> && std::is_standard_layout_v<page_count>);
+static_assert(std::is_trivially_copyable_v<kb_count> && std::is_standard_layout_v<kb_count>);
+static_assert(std::is_trivially_copyable_v<mb_count> && std::is_standard_layout_v<mb_count>);
+static_assert(std::is_trivially_copyable_v<gb_count> && std::is_standard_layout_v<gb_count>);
+static_assert(std::is_trivially_copyable_v<tb_count> && std::is_standard_layout_v<tb_count>);
+static_assert(sizeof(byte_count) == sizeof(std::size_t) && sizeof(wchar_count) == sizeof(std::size_t));
+static_assert(sizeof(page_count) == sizeof(std::size_t) && sizeof(tb_count) == sizeof(std::size_t));
+static_assert(std::is_trivially_copyable_v<char_count32> && std::is_standard_layout_v<char_count32>);
+static_assert(std::is_trivially_copyable_v<char_count16> && std::is_standard_layout_v<char_count16>);
+static_assert(sizeof(char_count32) == sizeof(std::uint32_t) && sizeof(char_count16) == sizeof(std::uint16_t));
+static_assert(std::is_trivially_copyable_v<checked_count_of<char>> && sizeof(checked_count_of<char>) == sizeof(std::size_t));
+static_assert(std::is_trivially_copyable_v<saturating_count_of<char>> && sizeof(saturating_count_of<char>) == sizeof(std::size_t));
+
+//! @}
+
+//! @defgroup literals Literals
+//! literal operators
+//! @{
+
+//! byte_count literal.
+constexpr byte_count operator "" _bt(unsigned long long count) noexcept
+{
+	return byte_count(static_cast<size_t>(count));
+}
+
+//! char_count literal.
+constexpr char_count operator "" _ch(unsigned long long count) noexcept
+{
+	return char_count(static_cast<size_t>(count));
+}
+
+//! wchar_count literal.
+constexpr wchar_count operator "" _wch(unsigned long long count) noexcept
+{
+	return wchar_count(static_cast<size_t>(count));
+}
+
+//! page_count literal.
+constexpr page_count operator "" _pg(unsigned long long count) noexcept
+{
+	return page_count(static_cast<size_t>(count));
+}
+
+//! kb_count literal.
+constexpr kb_count operator "" _kb(unsigned long long count) noexcept
+{
+	return kb_count(static_cast<size_t>(count));
+}
+
+//! mb_count literal.
+constexpr mb_count operator "" _mb(unsigned long long count) noexcept
+{
+	return mb_count(static_cast<size_t>(count));
+}
+
+//! gb_count literal.
+constexpr gb_count operator "" _gb(unsigned long long count) noexcept
+{
+	return gb_count(static_cast<size_t>(count));
+}
+
+//! tb_count literal.
+constexpr gb_count operator "" _tb(unsigned long long count) noexcept
+{
+	return gb_count(static_cast<size_t>(count));
+}
+
+//! bit_count literal.
+constexpr bit_count operator "" _bit(unsigned long long count) noexcept
+{
+	return bit_count(static_cast<size_t>(count));
+}
+
+//! @}
+
+//! @defgroup utilities Utilities
+//! Utility functions and classes
+//! @{
+
+//! Returns typed count of an array with a compile-time constant number of element.
+template <typename T, std::size_t N>
+constexpr count_of<T> array_size(T(&)[N]) noexcept
+{
+	return count_of<T>(N);
+}
+
+//! converts a count to a narrower Rep like char_count to char_count32.
+//!
+//! Returns 0 on success or ERANGE if src doesn't fit in ToRep, in which case dst is unchanged.
+template <typename T, typename ToRep, typename ToPolicy, typename FromRep, typename FromPolicy>
+constexpr int narrow_count_s(count_of<T, ToRep, ToPolicy>& dst, count_of<T, FromRep, FromPolicy> src) noexcept
+{
+	if (src.to_size() > std::numeric_limits<ToRep>::max())
+	{
+		return ERANGE;
+	}
+	dst = count_of<T, ToRep, ToPolicy>(src.to_size());
+	return 0;
+}
+
+namespace detail
+{
+
+//! ratio to convert counts of From to counts of To, reduced by GCD for compile-time units.
+template <typename From, typename To>
+constexpr runtime_ratio conversion_ratio() noexcept
+{
+	if constexpr (is_runtime_unit_v<From> || is_runtime_unit_v<To>)
+	{
+		const auto from = unit_runtime_ratio<From>();
+		const auto to = unit_runtime_ratio<To>();
+		return { from.num * to.den, from.den * to.num };
+	}
+	else
+	{
+		using ratio_t = unit_conversion_t<From, To>;
+		return { static_cast<std::size_t>(ratio_t::num), static_cast<std::size_t>(ratio_t::den) };
+	}
+}
+
+//! size of one Unit in units of T. Unit must be a multiple of T or divide it.
+//! 1 if every count of T is already a multiple of Unit.
+template <typename Unit, typename T>
+constexpr std::size_t unit_granularity() noexcept
+{
+	if constexpr (is_runtime_unit_v<Unit> || is_runtime_unit_v<T>)
+	{
+		const auto unit = unit_runtime_ratio<Unit>();
+		const auto elem = unit_runtime_ratio<T>();
+		const std::size_t num = unit.num * elem.den;
+		const std::size_t den = unit.den * elem.num;
+		assert(num % den == 0 || den % num == 0);
+		return num > den ? num / den : 1;
+	}
+	else
+	{
+		using ratio_t = unit_conversion_t<Unit, T>;
+		static_assert(ratio_t::den == 1 || ratio_t::num == 1, "Unit must be a multiple of T or divide it");
+		return static_cast<std::size_t>(ratio_t::num);
+	}
+}
+
+}
+
+//! rounds count up to a multiple of Unit.
+//!
+//! Like rounding an mmap length in bytes up to the page size by round_up_to<OsPage>(length).
+//! Uses mask arithmetic when the size of Unit in T is a power of two which is always the case
+//! for page sizes. The size of Unit must be a multiple of the size of T or divide it.
+//! Wraps around like other unsigned arithmetic if the result doesn't fit in size_t.
+template <typename Unit, typename T, typename Rep, typename Policy>
+constexpr count_of<T> round_up_to(count_of<T, Rep, Policy> count) noexcept
+{
+	const std::size_t granularity = detail::unit_granularity<Unit, T>();
+	if (detail::is_power_of_two(granularity))
+	{
+		return count_of<T>((count.to_size() + granularity - 1) & ~(granularity - 1));
+	}
+	return count_of<T>((count.to_size() + granularity - 1) / granularity * granularity);
+}
+
+//! converts count to a count of U rounding up instead of truncating.
+//!
+//! Like the bytes which hold a count of bits by ceil_count_of<std::byte>(bits), or the words
+//! of a bitmap by ceil_count_of<std::uint64_t>(bits). Quotient and remainder are scaled
+//! separately like to_count_of(), so the intermediate doesn't overflow.
+template <typename U, typename T, typename Rep, typename Policy>
+constexpr count_of<std::remove_cv_t<U>> ceil_count_of(count_of<T, Rep, Policy> count) noexcept
+{
+	const auto ratio = detail::conversion_ratio<T, std::remove_cv_t<U>>();
+	const std::size_t n = count.to_size();
+	return count_of<std::remove_cv_t<U>>(n / ratio.den * ratio.num + (n % ratio.den * ratio.num + ratio.den - 1) / ratio.den);
+}
+
+//! rounds count down to a multiple of Unit.
+//!
+//! Uses mask arithmetic when the size of Unit in T is a power of two.
+//! The size of Unit must be a multiple of the size of T or divide it.
+template <typename Unit, typename T, typename Rep, typename Policy>
+constexpr count_of<T> round_down_to(count_of<T, Rep, Policy> count) noexcept
+{
+	const std::size_t granularity = detail::unit_granularity<Unit, T>();
+	if (detail::is_power_of_two(granularity))
+	{
+		return count_of<T>(count.to_size() & ~(granularity - 1));
+	}
+	return count_of<T>(count.to_size() / granularity * granularity);
+}
+
+//! @}
+
+//! @defgroup bounds_checks Bounds checks
+//! Policies checking indexes of safe_array and fixed_size_array.
+//!
+//! TYPED_COUNT_BOUNDS_CHECK selects default_bounds_check: 0 for bounds_check_off,
+//! 1 for bounds_check_debug which is the default, and 2 for bounds_check_always.
+//! Iterators are raw pointers under every policy. The range [begin(), end()) is valid by
+//! construction, so a range-for or a std algorithm over an array needs no per-element check.
+//! @{
+
+//! No bounds checks.
+struct bounds_check_off
+{
+	static constexpr bool nothrow = true;
+
+	static constexpr void check_index(std::size_t, std::size_t) noexcept
+	{}
+
+	static constexpr void check_size(std::size_t, std::size_t) noexcept
+	{}
+};
+
+//! Asserts bounds. Free in NDEBUG builds.
+struct bounds_check_debug
+{
+	static constexpr bool nothrow = true;
+
+	//! index must be less than count.
+	static constexpr void check_index([[maybe_unused]] std::size_t index, [[maybe_unused]] std::size_t count) noexcept
+	{
+		assert(index < count);
+	}
+
+	//! size must not exceed count.
+	static constexpr void check_size([[maybe_unused]] std::size_t size, [[maybe_unused]] std::size_t count) noexcept
+	{
+		assert(size <= count);
+	}
+};
+
+//! Throws std::out_of_range on an out of bounds access in any build.
+struct bounds_check_always
+{
+	static constexpr bool nothrow = false;
+
+	static constexpr void check_index(std::size_t index, std::size_t count)
+	{
+		if (index >= count)
+		{
+			throw std::out_of_range("typed_count index out of range");
+		}
+	}
+
+	static constexpr void check_size(std::size_t size, std::size_t count)
+	{
+		if (size > count)
+		{
+			throw std::out_of_range("typed_count size out of range");
+		}
+	}
+};
+
+#ifndef TYPED_COUNT_BOUNDS_CHECK
+#define TYPED_COUNT_BOUNDS_CHECK 1
+#endif
+
+#if TYPED_COUNT_BOUNDS_CHECK == 0
+using default_bounds_check = bounds_check_off;
+#elif TYPED_COUNT_BOUNDS_CHECK == 2
+using default_bounds_check = bounds_check_always;
+#else
+using default_bounds_check = bounds_check_debug;
+#endif
+
+//! Range of typed counts [first, last)
+//!
+//! Iterates indexes of an array as typed counts when a loop needs the index. The indexes come
+//! from the count of the array, so index checks in the loop never fail and are predicted well.
+//! Loops which only need the elements should iterate the array itself, which has no checks at all.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! for (char_count i : name.indices())
+//! {
+//!     copy[i] = name[i];
+//! }
+//! @endcode
+template <typename T>
+class count_range
+{
+public:
+	class iterator
+	{
+		count_of<T> value_;
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = count_of<T>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const count_of<T>*;
+		using reference = count_of<T>;
+
+		constexpr iterator() noexcept = default;
+
+		constexpr explicit iterator(count_of<T> value) noexcept
+			: value_(value)
+		{}
+
+		constexpr count_of<T> operator *() const noexcept
+		{
+			return value_;
+		}
+
+		constexpr iterator& operator ++() noexcept
+		{
+			++value_;
+			return *this;
+		}
+
+		constexpr iterator operator ++(int) noexcept
+		{
+			iterator r(*this);
+			++value_;
+			return r;
+		}
+
+		constexpr bool operator ==(const iterator& other) const noexcept
+		{
+			return value_ == other.value_;
+		}
+
+		constexpr bool operator !=(const iterator& other) const noexcept
+		{
+			return value_ != other.value_;
+		}
+	};
+
+	//! ctor. first must not exceed last.
+	constexpr count_range(count_of<T> first, count_of<T> last) noexcept
+		: first_(first), last_(last)
+	{
+		assert(first <= last);
+	}
+
+	constexpr iterator begin() const noexcept
+	{
+		return iterator(first_);
+	}
+
+	constexpr iterator end() const noexcept
+	{
+		return iterator(last_);
+	}
+
+	constexpr count_of<T> count() const noexcept
+	{
+		return last_ - first_;
+	}
+
+private:
+	count_of<T> first_;
+	count_of<T> last_;
+};
+
+//! @}
+
+//! @addtogroup utilities
+//! @{
+
+//! Fixed size array
+//!
+//! Can access to elements using typed count. Indexes are checked by Check.
+//!
+//! <h4>Usage</h4>
+//! @code
+//! fixed_size_array<char, 10> buf;			// same as char arr[10];
+//! buf[0_ch] = 'A';
+//! buf[1] = 'B';							// won't compile
+//! assert(buf.count() == 10_ch);			// count() returns typed count
+//! char* pBuf = buf;						// supports decaying to pointer
+//! for (char& c : buf) { c = ' '; }		// iterators are raw pointers
+//! @endcode
+template <typename T, std::size_t N, typename Check = default_bounds_check>
+struct fixed_size_array
+{
+	using count_t = count_of<std::remove_cv_t<T>>;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	T elems[N];
+
+	constexpr T& operator[](count_t idx) const noexcept(Check::nothrow)
+	{
+		Check::check_index(idx.to_size(), N);
+		return const_cast<T&>(elems[idx.to_size()]);
+	}
+
+	constexpr count_t count() const noexcept
+	{
+		return count_t(N);
+	}
+
+	constexpr iterator begin() noexcept
+	{
+		return elems;
+	}
+
+	constexpr const_iterator begin() const noexcept
+	{
+		return elems;
+	}
+
+	constexpr iterator end() noexcept
+	{
+		return elems + N;
+	}
+
+	constexpr const_iterator end() const noexcept
+	{
+		return elems + N;
+	}
+
+	//! returns indexes of the elements as typed counts.
+	constexpr count_range<std::remove_cv_t<T>> indices() const noexcept
+	{
+		return { count_t(0), count_t(N) };
+	}
+
+	constexpr operator T* const() const noexcept
+	{
+		return const_cast<T*>(&elems[0]);
+	}
+};
+
+//! Safe array with data and count
+//!
+//! safe_array tracks data pointer and count together, which means
+//! count will decrease as much as data pointer advances.
+//! It forces users to access an element using typed_count.
+//! It also supports pointer arithmetic, subscript operator,
+//! decaying to a plan pointer, and deferencing just like a pointer.
+//! Indexes and advances are checked by Check. begin() and end() are raw pointers.
+//! safe_array does not own the pointed-to array.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! const safe_array<char> pOrgData{new char[10], 10};
+//! char_count i = 0_ch;
+//! pOrgData[i++] = 'A';
+//! *(pOrgData + i) = 'B';
+//! safe_array<char> pCurData = pOrgData;
+//! pCurData += 2_ch;
+//! pCurData[0_ch] = 'C';
+//! ++pCurData;
+//! *pCurData = 'D';
+//! if (pOrgData)
+//! {
+//!     delete[] pOrgData;
+//! }
+//! @endcode
+template <typename T, typename Check = default_bounds_check>
+class safe_array
+{
+	using count_t = count_of<std::remove_cv_t<T>>;
+
+	T* pElems_;
+	count_t count_;
+
+public:
+	using iterator = T*;
+
+	constexpr safe_array() noexcept
+		: safe_array(nullptr, 0)
+	{}
+
+	constexpr safe_array(T* pElems, std::size_t count) noexcept
+		: safe_array(pElems, count_t(count))
+	{}
+
+	//! converts fixed_size_array<U, N> where U* converts to T* like char to const char.
+	template <typename U, std::size_t N, typename UCheck, typename = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+	constexpr safe_array(const fixed_size_array<U, N, UCheck>& fixed_array)
+		: safe_array(fixed_array, fixed_array.count())
+	{}
+
+	//! converts safe_array<U> where U* converts to T* like safe_array<char> to safe_array<const char>.
+	//!
+	//! Also converts between check policies.
+	template <typename U, typename UCheck,
+		typename = std::enable_if_t<!(std::is_same_v<U, T> && std::is_same_v<UCheck, Check>) && std::is_convertible_v<U(*)[], T(*)[]>>>
+	constexpr safe_array(const safe_array<U, UCheck>& other) noexcept
+		: safe_array(other.data(), other.count())
+	{}
+
+	constexpr safe_array(T* pElems, const count_t& count) noexcept
+		: pElems_(pElems), count_(count)
+	{}
+
+	constexpr T& operator[](count_t idx) const noexcept(Check::nothrow)
+	{
+		Check::check_index(idx.to_size(), count_.to_size());
+		return pElems_[idx.to_size()];
+	}
+
+	constexpr count_t count() const noexcept
+	{
+		return count_;
+	}
+
+	constexpr iterator begin() const noexcept
+	{
+		return pElems_;
+	}
+
+	constexpr iterator end() const noexcept
+	{
+		return pElems_ + count_.to_size();
+	}
+
+	//! returns indexes of the elements as typed counts.
+	constexpr count_range<std::remove_cv_t<T>> indices() const noexcept
+	{
+		return { count_t(0), count_ };
+	}
+
+	//! @name slicing
+	//! Non-owning views of a part of the array. They are pointer arithmetic only.
+	//! Offsets and lengths can't exceed count() and are checked by Check.
+	//! @{
+
+	//! returns length elements starting at offset.
+	constexpr safe_array subarray(count_t offset, count_t length) const noexcept(Check::nothrow)
+	{
+		Check::check_size(offset.to_size(), count_.to_size());
+		Check::check_size(length.to_size(), count_.to_size() - offset.to_size());
+		return safe_array(pElems_ + offset.to_size(), length);
+	}
+
+	//! returns the elements from offset to the end.
+	constexpr safe_array subarray(count_t offset) const noexcept(Check::nothrow)
+	{
+		Check::check_size(offset.to_size(), count_.to_size());
+		return safe_array(pElems_ + offset.to_size(), count_ - offset);
+	}
+
+	//! returns the first length elements.
+	constexpr safe_array first(count_t length) const noexcept(Check::nothrow)
+	{
+		Check::check_size(length.to_size(), count_.to_size());
+		return safe_array(pElems_, length);
+	}
+
+	//! returns the last length elements.
+	constexpr safe_array last(count_t length) const noexcept(Check::nothrow)
+	{
+		Check::check_size(length.to_size(), count_.to_size());
+		return safe_array(pElems_ + (count_ - length).to_size(), length);
+	}
+
+	//! returns all elements but the last length elements.
+	constexpr safe_array drop_back(count_t length) const noexcept(Check::nothrow)
+	{
+		Check::check_size(length.to_size(), count_.to_size());
+		return safe_array(pElems_, count_ - length);
+	}
+
+	//! splits the array into the first offset elements and the rest.
+	//!
+	//! <h4>Usage</h4>
+	//! @code{.cpp}
+	//! auto [header, body] = packet.split_at(header_size);
+	//! @endcode
+	constexpr std::pair<safe_array, safe_array> split_at(count_t offset) const noexcept(Check::nothrow)
+	{
+		Check::check_size(offset.to_size(), count_.to_size());
+		return { safe_array(pElems_, offset), safe_array(pElems_ + offset.to_size(), count_ - offset) };
+	}
+
+	//! @}
+
+#if defined(__cpp_lib_span)
+	//! converts std::span<U> where U* converts to T* like std::span<char> to safe_array<const char>.
+	template <typename U, std::size_t Extent, typename = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+	constexpr safe_array(std::span<U, Extent> span) noexcept
+		: safe_array(span.data(), count_t(span.size()))
+	{}
+
+	//! converts to std::span<U> where T* converts to U* like safe_array<char> to std::span<const char>.
+	template <typename U, typename = std::enable_if_t<std::is_convertible_v<T(*)[], U(*)[]>>>
+	constexpr operator std::span<U>() const noexcept
+	{
+		return std::span<U>(pElems_, count_.to_size());
+	}
+#endif
+
+	constexpr operator bool() const noexcept
+	{
+		return pElems_ && count_ > count_t(0);
+	}
+
+	//! distance can't exceed count().
+	safe_array& operator +=(count_t distance) noexcept(Check::nothrow)
+	{
+		Check::check_size(distance.to_size(), count_.to_size());
+		pElems_ += distance.to_size();
+		count_ -= distance;
+		return *this;
+	}
+
+	//! distance can't exceed count().
+	safe_array operator +(count_t distance) const noexcept(Check::nothrow)
+	{
+		Check::check_size(distance.to_size(), count_.to_size());
+		return safe_array(pElems_ + distance.to_size(), count_ - distance);
+	}
+
+	safe_array& operator ++() noexcept(Check::nothrow)
+	{
+		*this += count_t(1);
+		return *this;
+	}
+
+	safe_array operator ++(int) noexcept(Check::nothrow)
+	{
+		safe_array t(*this);
+		*this += count_t(1);
+		return t;
+	}
+
+	T& operator *() const noexcept(Check::nothrow)
+	{
+		Check::check_index(0, count_.to_size());
+		return *pElems_;
+	}
+
+	constexpr T* data() const noexcept
+	{
+		return const_cast<T*>(pElems_);
+	}
+
+	constexpr operator T* const() const noexcept
+	{
+		return data();
+	}
+};
+
+//! nullptr for wchar safe array
+constexpr safe_array<wchar_t> nullptr_wchar_array{};
+
+//! @addtogroup layout_checks
+//! safe_array<T> must be a trivially copyable pointer and count pair, and fixed_size_array<T, N>
+//! must be laid out exactly like T[N].
+//! @{
+
+static_assert(std::is_trivially_copyable_v<safe_array<char>> && std::is_standard_layout_v<safe_array<char>>);
+static_assert(std::is_trivially_copyable_v<safe_array<const wchar_t>> && std::is_standard_layout_v<safe_array<const wchar_t>>);
+static_assert(sizeof(safe_array<char>) == sizeof(char*) + sizeof(std::size_t));
+static_assert(std::is_trivially_copyable_v<fixed_size_array<char, 8>> && std::is_standard_layout_v<fixed_size_array<char, 8>>);
+static_assert(std::is_trivially_copyable_v<fixed_size_array<const wchar_t, 8>> && std::is_standard_layout_v<fixed_size_array<const wchar_t, 8>>);
+static_assert(sizeof(fixed_size_array<wchar_t, 8>) == sizeof(wchar_t[8]));
+
+//! @}
+
+//! type-safe string length for char type
+//!
+//! Uses a SSE2/AVX2/NEON kernel selected at runtime.
+inline char_count str_len_s(const char* psz) noexcept
+{
+	return char_count(detail::str_nlen(psz, SIZE_MAX));
+}
+
+//! type-safe string length for wchar_t type
+//!
+//! Uses a SSE2/AVX2/NEON kernel selected at runtime.
+inline wchar_count str_len_s(const wchar_t* pwsz) noexcept
+{
+	return wchar_count(detail::str_nlen(pwsz, SIZE_MAX));
+}
+
+//! type-safe bounded string length for char type
+//!
+//! Returns count of chars before the first null char but never scans beyond count().
+//! So, it is safe to use on untrusted buffers which may not be null-terminated.
+//! The scan only reads aligned blocks and never crosses into a page outside the array.
+inline char_count str_nlen_s(safe_array<const char> sz) noexcept
+{
+	return char_count(detail::str_nlen(sz.data(), sz.count().to_size()));
+}
+
+//! type-safe bounded string length for wchar_t type
+//!
+//! Returns count of wchars before the first null wchar but never scans beyond count().
+//! So, it is safe to use on untrusted buffers which may not be null-terminated.
+//! The scan only reads aligned blocks and never crosses into a page outside the array.
+inline wchar_count str_nlen_s(safe_array<const wchar_t> wsz) noexcept
+{
+	return wchar_count(detail::str_nlen(wsz.data(), wsz.count().to_size()));
+}
+
+namespace detail
+{
+
+//! portable strcpy_s()/wcscpy_s().
+//!
+//! On failure, the destination becomes an empty string if it has room for one.
+template <typename CharT>
+int str_cpy(const CharT* src, CharT* dest, std::size_t len) noexcept
+{
+	if (!dest || len == 0)
+	{
+		return EINVAL;
+	}
+	if (!src)
+	{
+		dest[0] = CharT(0);
+		return EINVAL;
+	}
+
+	const std::size_t src_len = str_nlen(src, len);
+	if (src_len == len)
+	{
+		dest[0] = CharT(0);
+		return ERANGE;
+	}
+	std::memcpy(dest, src, (src_len + 1) * sizeof(CharT));
+	return 0;
+}
+
+//! blocks template argument deduction so that T is deduced only from count_of<T>.
+template <typename T>
+struct type_identity
+{
+	using type = T;
+};
+
+template <typename T>
+using type_identity_t = typename type_identity<T>::type;
+
+//! copies larger than this many bytes use non-temporal stores.
+inline std::atomic<std::size_t> non_temporal_threshold{ std::size_t(1024) * 1024 };
+
+}
+
+//! type-safe string copy for wchar_t
+//!
+//! Portable version of wcscpy_s(). len is the capacity of pwsz_dest including the null terminator.
+//! Returns 0 on success, EINVAL for null pointers or 0 len, and ERANGE if pwsz_src doesn't fit.
+inline int str_cpy_s(const wchar_t* pwsz_src, wchar_t* pwsz_dest, wchar_count len) noexcept
+{
+	return detail::str_cpy(pwsz_src, pwsz_dest, len.to_size());
+}
+
+//! type-safe string copy for char
+//!
+//! Portable version of strcpy_s(). len is the capacity of psz_dest including the null terminator.
+//! Returns 0 on success, EINVAL for null pointers or 0 len, and ERANGE if psz_src doesn't fit.
+inline int str_cpy_s(const char* psz_src, char* psz_dest, char_count len) noexcept
+{
+	return detail::str_cpy(psz_src, psz_dest, len.to_size());
+}
+
+//! @name memory functions
+//! type-safe versions of memcpy(), memmove(), memset() and memcmp().
+//!
+//! T is deduced only from count_of<T>, so buffers of a different unit don't compile
+//! and fixed_size_array can be passed where safe_array is expected.
+//! Counts are converted to bytes only once via to_byte_count().
+//! Functions returning int return 0 on success, EINVAL for a null buffer, and ERANGE
+//! if n exceeds count() of any buffer in which case no memory is touched.
+//! @{
+
+//! returns the size above which mem_cpy_s() uses non-temporal stores.
+inline kb_count non_temporal_threshold() noexcept
+{
+	return byte_count(detail::non_temporal_threshold.load(std::memory_order_relaxed)).to_count_of<Kb>();
+}
+
+//! sets the size above which mem_cpy_s() uses non-temporal stores.
+//!
+//! Should be around the share of the last level cache a thread is expected to use.
+//! Copies larger than that would evict the working set anyway.
+inline void set_non_temporal_threshold(kb_count threshold) noexcept
+{
+	detail::non_temporal_threshold.store(threshold.to_byte_count(), std::memory_order_relaxed);
+}
+
+//! type-safe memcpy().
+template <typename T, typename Rep, typename Policy>
+int mem_cpy_s(detail::type_identity_t<safe_array<T>> dst, detail::type_identity_t<safe_array<const T>> src, count_of<T, Rep, Policy> n) noexcept
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	if (n > dst.count() || n > src.count())
+	{
+		return ERANGE;
+	}
+	if (n == count_of<T>(0))
+	{
+		return 0;
+	}
+	if (!dst.data() || !src.data())
+	{
+		return EINVAL;
+	}
+
+	const std::size_t bytes = n.to_byte_count();
+	if (bytes > detail::non_temporal_threshold.load(std::memory_order_relaxed))
+	{
+		detail::mem_cpy_non_temporal(dst.data(), src.data(), bytes);
+	}
+	else
+	{
+		std::memcpy(dst.data(), src.data(), bytes);
+	}
+	return 0;
+}
+
+//! type-safe memcpy() for fixed size arrays.
+//!
+//! Size is checked at compile time and the copy is inlined as a constant-size copy.
+template <typename T, typename U, std::size_t N, std::size_t M>
+void mem_cpy_s(fixed_size_array<T, N>& dst, const fixed_size_array<U, M>& src) noexcept
+{
+	static_assert(std::is_same_v<std::remove_cv_t<T>, std::remove_cv_t<U>>, "element types must match");
+	static_assert(!std::is_const_v<T>, "destination must not be const");
+	static_assert(std::is_trivially_copyable_v<T>);
+	static_assert(M <= N, "source doesn't fit in destination");
+
+	std::memcpy(dst.elems, src.elems, sizeof(src.elems));
+}
+
+//! type-safe memmove().
+template <typename T, typename Rep, typename Policy>
+int mem_move_s(detail::type_identity_t<safe_array<T>> dst, detail::type_identity_t<safe_array<const T>> src, count_of<T, Rep, Policy> n) noexcept
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	if (n > dst.count() || n > src.count())
+	{
+		return ERANGE;
+	}
+	if (n == count_of<T>(0))
+	{
+		return 0;
+	}
+	if (!dst.data() || !src.data())
+	{
+		return EINVAL;
+	}
+
+	std::memmove(dst.data(), src.data(), n.to_byte_count());
+	return 0;
+}
+
+//! type-safe memset() which fills n elements with value.
+template <typename T, typename Rep, typename Policy>
+int mem_set_s(detail::type_identity_t<safe_array<T>> dst, detail::type_identity_t<T> value, count_of<T, Rep, Policy> n) noexcept
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	if (n > dst.count())
+	{
+		return ERANGE;
+	}
+	if (n == count_of<T>(0))
+	{
+		return 0;
+	}
+	if (!dst.data())
+	{
+		return EINVAL;
+	}
+
+	if constexpr (sizeof(T) == 1)
+	{
+		unsigned char byte;
+		std::memcpy(&byte, &value, 1);
+		std::memset(dst.data(), byte, n.to_byte_count());
+	}
+	else
+	{
+		std::fill_n(dst.data(), n.to_size(), value);
+	}
+	return 0;
+}
+
+//! type-safe memcmp().
+//!
+//! Compares the first n elements of lhs and rhs byte-wise like memcmp() and stores the
+//! result in diff like memcmp_s() of C11 Annex K: less than, equal to or greater than 0.
+//! Returns ERANGE if n exceeds count() of either array, EINVAL if n isn't 0 and an array
+//! is null, and 0 otherwise. diff is 0 on an error.
+template <typename T, typename Rep, typename Policy>
+int mem_cmp_s(detail::type_identity_t<safe_array<const T>> lhs, detail::type_identity_t<safe_array<const T>> rhs, count_of<T, Rep, Policy> n, int& diff) noexcept
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	diff = 0;
+	if (n > lhs.count() || n > rhs.count())
+	{
+		return ERANGE;
+	}
+	if (n == count_of<T>(0))
+	{
+		return 0;
+	}
+	if (!lhs.data() || !rhs.data())
+	{
+		return EINVAL;
+	}
+
+	diff = std::memcmp(lhs.data(), rhs.data(), n.to_byte_count());
+	return 0;
+}
+
+//! @}
+
+template <typename T, typename Rep, typename Policy>
+T* make_array(count_of<T, Rep, Policy> count)
+{
+	// new[] operator requires std::size_t argument. So we need to_size() method
+	return new T[count.to_size()];
+}
+
+template <typename T, typename Rep, typename Policy>
+safe_array<T> make_safe_array(count_of<T, Rep, Policy> count)
+{
+	// new[] operator requires std::size_t argument. So we need to_size() method
+	return { new T[count.to_size()], count };
+}
+
+//! allocates an array on the stack.
+//!
+//! There is no limit on count, so a data-dependent count can overflow the stack.
+//! small_buffer in small_buffer.h uses inline storage up to a threshold and the heap above it.
+template <typename T, typename Rep, typename Policy>
+[[deprecated("use small_buffer")]] T* alloca_array(count_of<T, Rep, Policy> count)
+{
+	return (T*)alloca(count.to_byte_count());
+}
+
+//! Default deleter of unique_safe_array which deletes an array allocated by new[].
+template <typename T>
+struct default_array_delete
+{
+	void operator()(safe_array<T> array) const noexcept
+	{
+		delete[] array.data();
+	}
+};
+
+//! Owning safe array
+//!
+//! unique_safe_array owns an array allocated by new[] and deletes it when it goes out of scope.
+//! It is move-only and keeps the typed count together with the pointer like safe_array does.
+//! It converts to a non-owning safe_array view which must not outlive it.
+//! Arrays allocated differently are released by Deleter which is called with the owned
+//! safe_array. An empty Deleter doesn't increase the size.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! auto pBuf = make_safe_array_for_overwrite(16_ch);
+//! str_cpy_s("ABCD", pBuf.data(), pBuf.count());
+//! safe_array<const char> view = pBuf;		// non-owning view
+//! auto pOther = std::move(pBuf);			// pBuf is now empty
+//! @endcode
+template <typename T, typename Deleter = default_array_delete<T>>
+class unique_safe_array : private Deleter
+{
+	using count_t = count_of<std::remove_cv_t<T>>;
+
+	safe_array<T> array_;
+
+public:
+	constexpr unique_safe_array() noexcept = default;
+
+	//! takes ownership of an array which Deleter can release.
+	constexpr explicit unique_safe_array(safe_array<T> array, Deleter deleter = Deleter()) noexcept
+		: Deleter(std::move(deleter)), array_(array)
+	{}
+
+	unique_safe_array(const unique_safe_array&) = delete;
+	unique_safe_array& operator =(const unique_safe_array&) = delete;
+
+	unique_safe_array(unique_safe_array&& other) noexcept
+		: Deleter(std::move(other.get_deleter())), array_(other.release())
+	{}
+
+	unique_safe_array& operator =(unique_safe_array&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset(other.release());
+			get_deleter() = std::move(other.get_deleter());
+		}
+		return *this;
+	}
+
+	~unique_safe_array()
+	{
+		if (array_.data())
+		{
+			get_deleter()(array_);
+		}
+	}
+
+	//! returns a non-owning view.
+	constexpr safe_array<T> get() const noexcept
+	{
+		return array_;
+	}
+
+	//! supports conversion to a non-owning view.
+	constexpr operator safe_array<T>() const noexcept
+	{
+		return array_;
+	}
+
+	//! supports conversion to a non-owning read-only view.
+	template <typename U = T, typename = std::enable_if_t<!std::is_const_v<U>>>
+	constexpr operator safe_array<const U>() const noexcept
+	{
+		return array_;
+	}
+
+	//! returns the deleter.
+	Deleter& get_deleter() noexcept
+	{
+		return *this;
+	}
+
+	//! returns the deleter.
+	const Deleter& get_deleter() const noexcept
+	{
+		return *this;
+	}
+
+	//! releases the ownership and returns the array.
+	safe_array<T> release() noexcept
+	{
+		auto array = array_;
+		array_ = safe_array<T>();
+		return array;
+	}
+
+	//! releases the owned array and takes ownership of a new one.
+	void reset(safe_array<T> array = safe_array<T>()) noexcept
+	{
+		auto old = array_;
+		array_ = array;
+		if (old.data())
+		{
+			get_deleter()(old);
+		}
+	}
+
+	constexpr T& operator[](count_t idx) const
+	{
+		return array_[idx];
+	}
+
+	constexpr count_t count() const noexcept
+	{
+		return array_.count();
+	}
+
+	constexpr T* data() const noexcept
+	{
+		return array_.data();
+	}
+
+	constexpr explicit operator bool() const noexcept
+	{
+		return static_cast<bool>(array_);
+	}
+};
+
+static_assert(sizeof(unique_safe_array<char>) == sizeof(safe_array<char>));
+
+//! allocates a value-initialized owning safe array.
+template <typename T, typename Rep, typename Policy>
+unique_safe_array<T> make_unique_safe_array(count_of<T, Rep, Policy> count)
+{
+	return unique_safe_array<T>({ new T[count.to_size()](), count });
+}
+
+//! allocates a default-initialized owning safe array.
+//!
+//! Elements of trivial types are left uninitialized, so use it for buffers which are
+//! going to be overwritten anyway.
+template <typename T, typename Rep, typename Policy>
+unique_safe_array<T> make_safe_array_for_overwrite(count_of<T, Rep, Policy> count)
+{
+	return unique_safe_array<T>({ new T[count.to_size()], count });
+}
+
+//! @}
+}
+
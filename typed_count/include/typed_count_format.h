@@ -0,0 +1,149 @@
+﻿#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#if __has_include(<version>)
+#include <version>
+#endif
+#if defined(__cpp_lib_format)
+#include <algorithm>
+#include <format>
+#endif
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! chars which hold any count formatted by format_to() in any style.
+constexpr char_count formatted_count_max = char_count(32);
+
+//! Style of format_to().
+enum class count_style
+{
+	plain,	//!< the count like 1536.
+	human,	//!< the size in bytes scaled to B, KiB, MiB, GiB or TiB like 1.5 MiB.
+};
+
+namespace detail
+{
+
+//! A binary prefix unit of the human style.
+struct human_unit
+{
+	const char* name;
+	double bytes;
+};
+
+constexpr human_unit human_units[] = {
+	{ "B", 1.0 },
+	{ "KiB", static_cast<double>(unit_ratio_t<Kb>::num) },
+	{ "MiB", static_cast<double>(unit_ratio_t<Mb>::num) },
+	{ "GiB", static_cast<double>(unit_ratio_t<Gb>::num) },
+	{ "TiB", static_cast<double>(unit_ratio_t<Tb>::num) },
+};
+
+//! writes bytes with one decimal in the largest unit it reaches and returns the end, or nullptr.
+inline char* format_human(char* first, char* last, double bytes) noexcept
+{
+	constexpr std::size_t units = sizeof(human_units) / sizeof(human_units[0]);
+	std::size_t unit = 0;
+	while (unit + 1 < units && bytes >= human_units[unit + 1].bytes)
+	{
+		++unit;
+	}
+	double tenths = std::round(bytes / human_units[unit].bytes * 10);
+	// 1023.96 KiB rounds to 1024.0 KiB, which is printed as 1 MiB.
+	if (unit + 1 < units && tenths >= human_units[unit + 1].bytes / human_units[unit].bytes * 10)
+	{
+		++unit;
+		tenths = std::round(bytes / human_units[unit].bytes * 10);
+	}
+	const bool whole = std::fmod(tenths, 10) == 0;
+	const auto r = std::to_chars(first, last, tenths / 10, std::chars_format::fixed, whole ? 0 : 1);
+	const std::size_t name = std::strlen(human_units[unit].name);
+	if (r.ec != std::errc() || static_cast<std::size_t>(last - r.ptr) < name + 1)
+	{
+		return nullptr;
+	}
+	*r.ptr = ' ';
+	std::memcpy(r.ptr + 1, human_units[unit].name, name);
+	return r.ptr + 1 + name;
+}
+
+}
+
+//! formats a count to dst and returns chars written, or 0_ch if it doesn't fit.
+//!
+//! Like std::to_chars(), the chars aren't null-terminated and nothing is allocated or
+//! locale-dependent. The plain style writes the count. The human style writes the size in
+//! bytes in the largest binary unit it reaches with at most one decimal, like 512 B,
+//! 1.5 MiB or 2 GiB, for a count of any unit including runtime units like Page.
+//! A dst of formatted_count_max chars always fits.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! fixed_size_array<char, formatted_count_max.to_size()> text;
+//! char_count n = format_to(text, mapped.count(), count_style::human);
+//! log_write(safe_array<const char>(text).first(n));
+//! @endcode
+template <typename T, typename Rep, typename Policy>
+char_count format_to(safe_array<char> dst, count_of<T, Rep, Policy> count, count_style style = count_style::plain) noexcept
+{
+	char* const first = dst.data();
+	char* const last = first + dst.count().to_size();
+	if (style == count_style::plain)
+	{
+		const auto r = std::to_chars(first, last, count.to_size());
+		return r.ec == std::errc() ? char_count(static_cast<std::size_t>(r.ptr - first)) : 0_ch;
+	}
+	const auto ratio = detail::unit_runtime_ratio<T>();
+	char* const end = detail::format_human(first, last, static_cast<double>(count.to_size()) * ratio.num / ratio.den);
+	return end ? char_count(static_cast<std::size_t>(end - first)) : 0_ch;
+}
+
+//! @}
+
+}
+
+#if defined(__cpp_lib_format)
+
+//! formats a count by std::format() like format_to().
+//!
+//! {} is the plain style and {:h} is the human style. The count is formatted on the stack,
+//! so nothing is allocated unless the output iterator does.
+template <typename T, typename Rep, typename Policy>
+struct std::formatter<typed_count::count_of<T, Rep, Policy>, char>
+{
+	typed_count::count_style style = typed_count::count_style::plain;
+
+	constexpr auto parse(std::format_parse_context& ctx)
+	{
+		auto it = ctx.begin();
+		if (it != ctx.end() && *it == 'h')
+		{
+			style = typed_count::count_style::human;
+			++it;
+		}
+		if (it != ctx.end() && *it != '}')
+		{
+			throw std::format_error("invalid format of count_of");
+		}
+		return it;
+	}
+
+	template <typename FormatContext>
+	auto format(typed_count::count_of<T, Rep, Policy> count, FormatContext& ctx) const
+	{
+		typed_count::fixed_size_array<char, typed_count::formatted_count_max.to_size()> text;
+		const auto n = typed_count::format_to(text, count, style);
+		return std::copy_n(text.elems, n.to_size(), ctx.out());
+	}
+};
+
+#endif
@@ -0,0 +1,913 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__SSE2__) && defined(__i386__)) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TYPED_COUNT_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define TYPED_COUNT_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only inline AVX2 helpers into functions which are compiled for AVX2 as well.
+// AVX2 entry points are flattened so that the shared loop and its helpers are inlined into them.
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TYPED_COUNT_TARGET_AVX2
+#define TYPED_COUNT_FLATTEN
+#else
+#define TYPED_COUNT_TARGET_AVX2 __attribute__((target("avx2")))
+#define TYPED_COUNT_FLATTEN __attribute__((flatten))
+#endif
+
+// The vector kernels deliberately read whole aligned blocks which may extend past the end of
+// a string. Aligned blocks never cross a page boundary, so this can't fault, but address sanitizer
+// would report it.
+#if defined(__clang__) || defined(__GNUC__)
+#define TYPED_COUNT_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#elif defined(_MSC_VER)
+#define TYPED_COUNT_NO_SANITIZE_ADDRESS __declspec(no_sanitize_address)
+#else
+#define TYPED_COUNT_NO_SANITIZE_ADDRESS
+#endif
+
+//! SIMD kernels behind the type-safe string and memory functions.
+//!
+//! Kernels are selected once at runtime based on CPU features and work on plain pointers
+//! and element counts in size_t. Typed wrappers are in typed_count_core.h.
+namespace typed_count::detail
+{
+
+//! index of the lowest set bit. mask must not be 0.
+inline unsigned count_trailing_zeros(std::uint64_t mask) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+//! @name str_nlen kernels
+//! Return the number of elements before the first null element, but at most max.
+//! max == SIZE_MAX scans an unbounded null-terminated string.
+//! @{
+
+template <typename CharT>
+std::size_t str_nlen_scalar(const CharT* p, std::size_t max) noexcept
+{
+	std::size_t i = 0;
+	while (i < max && p[i] != CharT(0))
+	{
+		++i;
+	}
+	return i;
+}
+
+//! Shared loop for the vector kernels.
+//!
+//! Vector::width is the block size in bytes, Vector::zero_mask() returns one bit per byte
+//! for the null bytes of an aligned block, and Vector::bits_per_byte is the number of mask
+//! bits per byte. Only aligned blocks are loaded, so the scan never touches a page which
+//! doesn't contain at least one element of the string.
+template <typename Vector, typename CharT>
+TYPED_COUNT_NO_SANITIZE_ADDRESS inline std::size_t str_nlen_vector(const CharT* p, std::size_t max) noexcept
+{
+	constexpr std::size_t elem_size = sizeof(CharT);
+	constexpr std::size_t bits_per_elem = elem_size * Vector::bits_per_byte;
+	constexpr std::size_t elems_per_block = Vector::width / elem_size;
+
+	if (max == 0)
+	{
+		return 0;
+	}
+
+	const auto addr = reinterpret_cast<std::uintptr_t>(p);
+	const auto offset = addr & (Vector::width - 1);
+	auto block = reinterpret_cast<const unsigned char*>(addr - offset);
+
+	// Ignores the bytes before p in the first block.
+	auto mask = Vector::template zero_mask<elem_size>(block) >> (offset * Vector::bits_per_byte);
+	std::size_t scanned = (Vector::width - offset) / elem_size;
+	if (mask)
+	{
+		const std::size_t found = count_trailing_zeros(mask) / bits_per_elem;
+		return found < max ? found : max;
+	}
+
+	while (scanned < max)
+	{
+		block += Vector::width;
+		mask = Vector::template zero_mask<elem_size>(block);
+		if (mask)
+		{
+			const std::size_t found = scanned + count_trailing_zeros(mask) / bits_per_elem;
+			return found < max ? found : max;
+		}
+		scanned += elems_per_block;
+	}
+
+	return max;
+}
+
+#if defined(TYPED_COUNT_SIMD_X86)
+
+//! SSE2 is part of the x86-64 baseline, so it needs no runtime check.
+struct sse2_vector
+{
+	static constexpr std::size_t width = 16;
+	static constexpr std::size_t bits_per_byte = 1;
+
+	template <std::size_t ElemSize>
+	TYPED_COUNT_NO_SANITIZE_ADDRESS static std::uint64_t zero_mask(const unsigned char* block) noexcept
+	{
+		const __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+		const __m128i zero = _mm_setzero_si128();
+		__m128i eq;
+		if constexpr (ElemSize == 1)
+		{
+			eq = _mm_cmpeq_epi8(v, zero);
+		}
+		else if constexpr (ElemSize == 2)
+		{
+			eq = _mm_cmpeq_epi16(v, zero);
+		}
+		else
+		{
+			static_assert(ElemSize == 4);
+			eq = _mm_cmpeq_epi32(v, zero);
+		}
+		return static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+	}
+};
+
+struct avx2_vector
+{
+	static constexpr std::size_t width = 32;
+	static constexpr std::size_t bits_per_byte = 1;
+
+	template <std::size_t ElemSize>
+	TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_NO_SANITIZE_ADDRESS static std::uint64_t zero_mask(const unsigned char* block) noexcept
+	{
+		const __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(block));
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i eq;
+		if constexpr (ElemSize == 1)
+		{
+			eq = _mm256_cmpeq_epi8(v, zero);
+		}
+		else if constexpr (ElemSize == 2)
+		{
+			eq = _mm256_cmpeq_epi16(v, zero);
+		}
+		else
+		{
+			static_assert(ElemSize == 4);
+			eq = _mm256_cmpeq_epi32(v, zero);
+		}
+		return static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+	}
+};
+
+template <typename CharT>
+std::size_t str_nlen_sse2(const CharT* p, std::size_t max) noexcept
+{
+	return str_nlen_vector<sse2_vector>(p, max);
+}
+
+template <typename CharT>
+TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_FLATTEN std::size_t str_nlen_avx2(const CharT* p, std::size_t max) noexcept
+{
+	return str_nlen_vector<avx2_vector>(p, max);
+}
+
+//! true if both the CPU and the OS support AVX2.
+inline bool cpu_has_avx2() noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int regs[4];
+	__cpuid(regs, 0);
+	if (regs[0] < 7)
+	{
+		return false;
+	}
+	__cpuid(regs, 1);
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+	{
+		return false;
+	}
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(TYPED_COUNT_SIMD_NEON)
+
+//! NEON is part of the AArch64 baseline, so it needs no runtime check.
+//! There is no movemask on NEON. Narrowing shift produces 4 bits per byte instead.
+struct neon_vector
+{
+	static constexpr std::size_t width = 16;
+	static constexpr std::size_t bits_per_byte = 4;
+
+	template <std::size_t ElemSize>
+	TYPED_COUNT_NO_SANITIZE_ADDRESS static std::uint64_t zero_mask(const unsigned char* block) noexcept
+	{
+		const uint8x16_t v = vld1q_u8(block);
+		uint8x16_t eq;
+		if constexpr (ElemSize == 1)
+		{
+			eq = vceqzq_u8(v);
+		}
+		else if constexpr (ElemSize == 2)
+		{
+			eq = vreinterpretq_u8_u16(vceqzq_u16(vreinterpretq_u16_u8(v)));
+		}
+		else
+		{
+			static_assert(ElemSize == 4);
+			eq = vreinterpretq_u8_u32(vceqzq_u32(vreinterpretq_u32_u8(v)));
+		}
+		const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+		return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+	}
+};
+
+template <typename CharT>
+std::size_t str_nlen_neon(const CharT* p, std::size_t max) noexcept
+{
+	return str_nlen_vector<neon_vector>(p, max);
+}
+
+#endif
+
+template <typename CharT>
+using str_nlen_kernel_t = std::size_t (*)(const CharT*, std::size_t) noexcept;
+
+//! picks the widest str_nlen kernel the CPU supports.
+template <typename CharT>
+str_nlen_kernel_t<CharT> select_str_nlen_kernel() noexcept
+{
+	static_assert(sizeof(CharT) == 1 || sizeof(CharT) == 2 || sizeof(CharT) == 4);
+#if defined(TYPED_COUNT_SIMD_X86)
+	if (cpu_has_avx2())
+	{
+		return &str_nlen_avx2<CharT>;
+	}
+	return &str_nlen_sse2<CharT>;
+#elif defined(TYPED_COUNT_SIMD_NEON)
+	return &str_nlen_neon<CharT>;
+#else
+	return &str_nlen_scalar<CharT>;
+#endif
+}
+
+//! length of a string bounded by max using the kernel selected at the first call.
+template <typename CharT>
+std::size_t str_nlen(const CharT* p, std::size_t max) noexcept
+{
+	static const str_nlen_kernel_t<CharT> kernel = select_str_nlen_kernel<CharT>();
+	return kernel(p, max);
+}
+
+//! @}
+
+//! @name ASCII kernels of the UTF transcoder
+//! Convert or scan the leading ASCII elements of a string, which are the same code units in
+//! UTF-8, UTF-16 and UTF-32, and return their count. Elements after it are left to the
+//! scalar UTF code.
+//! Converting kernels may write up to n elements to dst even if they return less.
+//! @{
+
+template <typename WideT>
+std::size_t widen_ascii_scalar(const char* src, std::size_t n, WideT* dst) noexcept
+{
+	std::size_t i = 0;
+	for (; i < n && static_cast<unsigned char>(src[i]) < 0x80; ++i)
+	{
+		dst[i] = static_cast<WideT>(src[i]);
+	}
+	return i;
+}
+
+//! narrows leading ASCII elements if Store or only counts them otherwise.
+template <bool Store, typename WideT>
+std::size_t narrow_ascii_scalar(const WideT* src, std::size_t n, char* dst) noexcept
+{
+	std::size_t i = 0;
+	for (; i < n && static_cast<std::uint32_t>(src[i]) < 0x80; ++i)
+	{
+		if constexpr (Store)
+		{
+			dst[i] = static_cast<char>(src[i]);
+		}
+	}
+	return i;
+}
+
+#if defined(TYPED_COUNT_SIMD_X86)
+
+template <typename WideT>
+std::size_t widen_ascii_sse2(const char* src, std::size_t n, WideT* dst) noexcept
+{
+	static_assert(sizeof(WideT) == 2 || sizeof(WideT) == 4);
+	const __m128i zero = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		const __m128i lo = _mm_unpacklo_epi8(v, zero);
+		const __m128i hi = _mm_unpackhi_epi8(v, zero);
+		auto d = reinterpret_cast<__m128i*>(dst + i);
+		if constexpr (sizeof(WideT) == 2)
+		{
+			_mm_storeu_si128(d, lo);
+			_mm_storeu_si128(d + 1, hi);
+		}
+		else
+		{
+			_mm_storeu_si128(d, _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(d + 1, _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(d + 2, _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(d + 3, _mm_unpackhi_epi16(hi, zero));
+		}
+		if (const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(v)))
+		{
+			return i + count_trailing_zeros(mask);
+		}
+	}
+	return i + widen_ascii_scalar(src + i, n - i, dst + i);
+}
+
+template <typename WideT>
+TYPED_COUNT_TARGET_AVX2 std::size_t widen_ascii_avx2(const char* src, std::size_t n, WideT* dst) noexcept
+{
+	static_assert(sizeof(WideT) == 2 || sizeof(WideT) == 4);
+	std::size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		const __m128i lo = _mm256_castsi256_si128(v);
+		const __m128i hi = _mm256_extracti128_si256(v, 1);
+		auto d = reinterpret_cast<__m256i*>(dst + i);
+		if constexpr (sizeof(WideT) == 2)
+		{
+			_mm256_storeu_si256(d, _mm256_cvtepu8_epi16(lo));
+			_mm256_storeu_si256(d + 1, _mm256_cvtepu8_epi16(hi));
+		}
+		else
+		{
+			_mm256_storeu_si256(d, _mm256_cvtepu8_epi32(lo));
+			_mm256_storeu_si256(d + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+			_mm256_storeu_si256(d + 2, _mm256_cvtepu8_epi32(hi));
+			_mm256_storeu_si256(d + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+		}
+		if (const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(v)))
+		{
+			return i + count_trailing_zeros(mask);
+		}
+	}
+	return i + widen_ascii_sse2(src + i, n - i, dst + i);
+}
+
+//! returns the number of leading bytes below 0x80.
+inline std::size_t ascii_prefix_sse2(const char* src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		if (const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(v)))
+		{
+			return i + count_trailing_zeros(mask);
+		}
+	}
+	for (; i < n && static_cast<unsigned char>(src[i]) < 0x80; ++i)
+	{}
+	return i;
+}
+
+TYPED_COUNT_TARGET_AVX2 inline std::size_t ascii_prefix_avx2(const char* src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 32 <= n; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		if (const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(v)))
+		{
+			return i + count_trailing_zeros(mask);
+		}
+	}
+	return i + ascii_prefix_sse2(src + i, n - i);
+}
+
+//! narrows leading ASCII elements 16 at a time if Store or only counts them otherwise.
+template <bool Store, typename WideT>
+std::size_t narrow_ascii_sse2(const WideT* src, std::size_t n, char* dst) noexcept
+{
+	static_assert(sizeof(WideT) == 2 || sizeof(WideT) == 4);
+	const __m128i zero = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		auto s = reinterpret_cast<const __m128i*>(src + i);
+		__m128i packed;
+		if constexpr (sizeof(WideT) == 2)
+		{
+			const __m128i a = _mm_loadu_si128(s);
+			const __m128i b = _mm_loadu_si128(s + 1);
+			const __m128i high = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16(static_cast<short>(0xFF80)));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF)
+			{
+				break;
+			}
+			packed = _mm_packus_epi16(a, b);
+		}
+		else
+		{
+			const __m128i a = _mm_loadu_si128(s);
+			const __m128i b = _mm_loadu_si128(s + 1);
+			const __m128i c = _mm_loadu_si128(s + 2);
+			const __m128i d = _mm_loadu_si128(s + 3);
+			const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+			const __m128i high = _mm_and_si128(any, _mm_set1_epi32(static_cast<int>(0xFFFFFF80)));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, zero)) != 0xFFFF)
+			{
+				break;
+			}
+			packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+		}
+		if constexpr (Store)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+		}
+	}
+	return i + narrow_ascii_scalar<Store>(src + i, n - i, Store ? dst + i : dst);
+}
+
+#endif
+
+template <typename WideT>
+using widen_ascii_kernel_t = std::size_t (*)(const char*, std::size_t, WideT*) noexcept;
+
+//! picks the widest ASCII widening kernel the CPU supports.
+template <typename WideT>
+widen_ascii_kernel_t<WideT> select_widen_ascii_kernel() noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	if (cpu_has_avx2())
+	{
+		return &widen_ascii_avx2<WideT>;
+	}
+	return &widen_ascii_sse2<WideT>;
+#else
+	return &widen_ascii_scalar<WideT>;
+#endif
+}
+
+//! widens leading ASCII bytes of src to dst using the kernel selected at the first call.
+template <typename WideT>
+std::size_t widen_ascii(const char* src, std::size_t n, WideT* dst) noexcept
+{
+	static const widen_ascii_kernel_t<WideT> kernel = select_widen_ascii_kernel<WideT>();
+	return kernel(src, n, dst);
+}
+
+//! counts leading ASCII bytes of src using the kernel selected at the first call.
+inline std::size_t ascii_prefix(const char* src, std::size_t n) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	static const auto kernel = cpu_has_avx2() ? &ascii_prefix_avx2 : &ascii_prefix_sse2;
+	return kernel(src, n);
+#else
+	return narrow_ascii_scalar<false>(reinterpret_cast<const unsigned char*>(src), n, nullptr);
+#endif
+}
+
+//! narrows leading ASCII elements of src to dst if Store or only counts them otherwise.
+//!
+//! The SSE2 kernel is used on x86. Packing 256-bit vectors crosses lanes, so there is no AVX2 kernel.
+template <bool Store, typename WideT>
+std::size_t narrow_ascii(const WideT* src, std::size_t n, char* dst) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	return narrow_ascii_sse2<Store>(src, n, dst);
+#else
+	return narrow_ascii_scalar<Store>(src, n, dst);
+#endif
+}
+
+//! @}
+
+//! @name column kernels
+//! Bulk operations of count_column on unsigned integers of 1 to 8 bytes. Sums and shifts
+//! are done in size_t and wrap around like wrap_policy does. AVX2 kernels handle 4 and 8 byte
+//! elements and the scalar ones handle the rest and the tails.
+//! @{
+
+template <typename Rep>
+std::size_t column_sum_scalar(const Rep* src, std::size_t n) noexcept
+{
+	std::size_t sum = 0;
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		sum += src[i];
+	}
+	return sum;
+}
+
+//! returns the largest element or 0 if n is 0.
+template <typename Rep>
+Rep column_max_scalar(const Rep* src, std::size_t n) noexcept
+{
+	Rep max = 0;
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		max = src[i] > max ? src[i] : max;
+	}
+	return max;
+}
+
+//! stores src[i] shifted left if Left or right otherwise by shift bits to dst[i].
+template <bool Left, typename In, typename Out>
+void column_shift_scalar(const In* src, std::size_t n, Out* dst, unsigned shift) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		const auto value = static_cast<std::size_t>(src[i]);
+		dst[i] = static_cast<Out>(Left ? value << shift : value >> shift);
+	}
+}
+
+//! stores sum plus the elements before src[i] to dst[i] and returns sum plus all elements.
+template <typename Rep>
+std::size_t column_exclusive_scan_scalar(const Rep* src, std::size_t n, std::size_t* dst, std::size_t sum) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		dst[i] = sum;
+		sum += src[i];
+	}
+	return sum;
+}
+
+#if defined(TYPED_COUNT_SIMD_X86)
+
+//! loads 4 elements zero-extended to 64-bit lanes.
+template <typename Rep>
+TYPED_COUNT_TARGET_AVX2 inline __m256i load_epu64_avx2(const Rep* src) noexcept
+{
+	if constexpr (sizeof(Rep) == 4)
+	{
+		return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+	}
+	else
+	{
+		return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+	}
+}
+
+template <typename Rep>
+TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_FLATTEN std::size_t column_sum_avx2(const Rep* src, std::size_t n) noexcept
+{
+	// Two accumulators hide the latency of the adds.
+	__m256i a = _mm256_setzero_si256();
+	__m256i b = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		a = _mm256_add_epi64(a, load_epu64_avx2(src + i));
+		b = _mm256_add_epi64(b, load_epu64_avx2(src + i + 4));
+	}
+	alignas(32) std::uint64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a, b));
+	return static_cast<std::size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + column_sum_scalar(src + i, n - i);
+}
+
+template <typename Rep>
+TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_FLATTEN Rep column_max_avx2(const Rep* src, std::size_t n) noexcept
+{
+	constexpr std::size_t width = 32 / sizeof(Rep);
+	__m256i max = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + width <= n; i += width)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		if constexpr (sizeof(Rep) == 4)
+		{
+			max = _mm256_max_epu32(max, v);
+		}
+		else
+		{
+			// There is no unsigned 64-bit compare. Flipping the sign bits makes the signed one work.
+			const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+			const __m256i greater = _mm256_cmpgt_epi64(_mm256_xor_si256(v, sign), _mm256_xor_si256(max, sign));
+			max = _mm256_blendv_epi8(max, v, greater);
+		}
+	}
+	alignas(32) Rep lanes[width];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), max);
+	const Rep vector_max = column_max_scalar(lanes, width);
+	const Rep tail_max = column_max_scalar(src + i, n - i);
+	return vector_max > tail_max ? vector_max : tail_max;
+}
+
+//! shifts 4 and 8 byte elements to elements of the same size, or 4 byte ones to 8 byte ones.
+template <bool Left, typename In, typename Out>
+TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_FLATTEN void column_shift_avx2(const In* src, std::size_t n, Out* dst, unsigned shift) noexcept
+{
+	// Shifts by 32 or more bits give 0 like the scalar shift of a 32-bit value in size_t.
+	const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+	std::size_t i = 0;
+	if constexpr (sizeof(In) == 4 && sizeof(Out) == 4)
+	{
+		for (; i + 8 <= n; i += 8)
+		{
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), Left ? _mm256_sll_epi32(v, count) : _mm256_srl_epi32(v, count));
+		}
+	}
+	else
+	{
+		static_assert(sizeof(Out) == 8);
+		for (; i + 4 <= n; i += 4)
+		{
+			const __m256i v = load_epu64_avx2(src + i);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), Left ? _mm256_sll_epi64(v, count) : _mm256_srl_epi64(v, count));
+		}
+	}
+	column_shift_scalar<Left>(src + i, n - i, dst + i, shift);
+}
+
+template <typename Rep>
+TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_FLATTEN std::size_t column_exclusive_scan_avx2(const Rep* src, std::size_t n, std::size_t* dst, std::size_t sum) noexcept
+{
+	static_assert(sizeof(std::size_t) == 8);
+	__m256i carry = _mm256_set1_epi64x(static_cast<long long>(sum));
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m256i v = load_epu64_avx2(src + i);
+		// [a, b | c, d] -> [a, a+b | c, c+d] -> [a, a+b | a+b+c, a+b+c+d]
+		__m256i x = _mm256_add_epi64(v, _mm256_slli_si256(v, 8));
+		x = _mm256_add_epi64(x, _mm256_blend_epi32(_mm256_setzero_si256(), _mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 1, 1, 1)), 0xF0));
+		x = _mm256_add_epi64(x, carry);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_sub_epi64(x, v));
+		carry = _mm256_permute4x64_epi64(x, _MM_SHUFFLE(3, 3, 3, 3));
+	}
+	return column_exclusive_scan_scalar(src + i, n - i, dst + i, static_cast<std::size_t>(_mm256_extract_epi64(carry, 0)));
+}
+
+#endif
+
+//! sums the elements of src using the kernel selected at the first call.
+template <typename Rep>
+std::size_t column_sum(const Rep* src, std::size_t n) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	if constexpr (sizeof(Rep) == 4 || sizeof(Rep) == 8)
+	{
+		static const auto kernel = cpu_has_avx2() ? &column_sum_avx2<Rep> : &column_sum_scalar<Rep>;
+		return kernel(src, n);
+	}
+#endif
+	return column_sum_scalar(src, n);
+}
+
+//! returns the largest element of src or 0 using the kernel selected at the first call.
+template <typename Rep>
+Rep column_max(const Rep* src, std::size_t n) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	if constexpr (sizeof(Rep) == 4 || sizeof(Rep) == 8)
+	{
+		static const auto kernel = cpu_has_avx2() ? &column_max_avx2<Rep> : &column_max_scalar<Rep>;
+		return kernel(src, n);
+	}
+#endif
+	return column_max_scalar(src, n);
+}
+
+//! shifts the elements of src to dst using the kernel selected at the first call.
+template <bool Left, typename In, typename Out>
+void column_shift(const In* src, std::size_t n, Out* dst, unsigned shift) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	if constexpr ((sizeof(In) == 4 || sizeof(In) == 8) && (sizeof(Out) == sizeof(In) || sizeof(Out) == 8))
+	{
+		static const auto kernel = cpu_has_avx2() ? &column_shift_avx2<Left, In, Out> : &column_shift_scalar<Left, In, Out>;
+		kernel(src, n, dst, shift);
+		return;
+	}
+#endif
+	column_shift_scalar<Left>(src, n, dst, shift);
+}
+
+//! stores the exclusive prefix sums of src to dst using the kernel selected at the first call.
+//!
+//! Returns the sum of all elements.
+template <typename Rep>
+std::size_t column_exclusive_scan(const Rep* src, std::size_t n, std::size_t* dst) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	if constexpr ((sizeof(Rep) == 4 || sizeof(Rep) == 8) && sizeof(std::size_t) == 8)
+	{
+		static const auto kernel = cpu_has_avx2() ? &column_exclusive_scan_avx2<Rep> : &column_exclusive_scan_scalar<Rep>;
+		return kernel(src, n, dst, 0);
+	}
+#endif
+	return column_exclusive_scan_scalar(src, n, dst, 0);
+}
+
+//! @}
+
+//! @name bit kernels
+//! Scan and combine bitmaps of 64-bit words for bit_view.
+//! @{
+
+inline unsigned popcount64(std::uint64_t word) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	// __popcnt64 needs a CPU with POPCNT.
+	word = word - ((word >> 1) & 0x5555555555555555);
+	word = (word & 0x3333333333333333) + ((word >> 2) & 0x3333333333333333);
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0F;
+	return static_cast<unsigned>((word * 0x0101010101010101) >> 56);
+#else
+	return static_cast<unsigned>(__builtin_popcountll(word));
+#endif
+}
+
+inline std::size_t bits_popcount_scalar(const std::uint64_t* words, std::size_t n) noexcept
+{
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		count += popcount64(words[i]);
+	}
+	return count;
+}
+
+//! returns the index of the first word which isn't 0, or n.
+inline std::size_t bits_find_word_scalar(const std::uint64_t* words, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i < n && words[i] == 0; ++i)
+	{}
+	return i;
+}
+
+//! stores dst[i] | src[i] to dst[i] if Or or dst[i] & src[i] otherwise.
+template <bool Or>
+void bits_combine_scalar(std::uint64_t* dst, const std::uint64_t* src, std::size_t n) noexcept
+{
+	for (std::size_t i = 0; i < n; ++i)
+	{
+		dst[i] = Or ? dst[i] | src[i] : dst[i] & src[i];
+	}
+}
+
+#if defined(TYPED_COUNT_SIMD_X86)
+
+//! counts bits by looking up the count of each nibble and summing the bytes of 4 words at a time.
+TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_FLATTEN inline std::size_t bits_popcount_avx2(const std::uint64_t* words, std::size_t n) noexcept
+{
+	const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+	__m256i total = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+		const __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_nibbles));
+		const __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles));
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+	}
+	alignas(32) std::uint64_t lanes[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), total);
+	return static_cast<std::size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + bits_popcount_scalar(words + i, n - i);
+}
+
+TYPED_COUNT_TARGET_AVX2 inline std::size_t bits_find_word_avx2(const std::uint64_t* words, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+		if (!_mm256_testz_si256(v, v))
+		{
+			break;
+		}
+	}
+	return i + bits_find_word_scalar(words + i, n - i);
+}
+
+template <bool Or>
+TYPED_COUNT_TARGET_AVX2 TYPED_COUNT_FLATTEN void bits_combine_avx2(std::uint64_t* dst, const std::uint64_t* src, std::size_t n) noexcept
+{
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+		const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), Or ? _mm256_or_si256(d, s) : _mm256_and_si256(d, s));
+	}
+	bits_combine_scalar<Or>(dst + i, src + i, n - i);
+}
+
+#endif
+
+//! counts set bits of n words using the kernel selected at the first call.
+inline std::size_t bits_popcount(const std::uint64_t* words, std::size_t n) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	static const auto kernel = cpu_has_avx2() ? &bits_popcount_avx2 : &bits_popcount_scalar;
+	return kernel(words, n);
+#else
+	return bits_popcount_scalar(words, n);
+#endif
+}
+
+//! returns the index of the first of n words which isn't 0, or n, using the kernel selected at the first call.
+inline std::size_t bits_find_word(const std::uint64_t* words, std::size_t n) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	static const auto kernel = cpu_has_avx2() ? &bits_find_word_avx2 : &bits_find_word_scalar;
+	return kernel(words, n);
+#else
+	return bits_find_word_scalar(words, n);
+#endif
+}
+
+//! ors or ands n words of src into dst using the kernel selected at the first call.
+template <bool Or>
+void bits_combine(std::uint64_t* dst, const std::uint64_t* src, std::size_t n) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	static const auto kernel = cpu_has_avx2() ? &bits_combine_avx2<Or> : &bits_combine_scalar<Or>;
+	kernel(dst, src, n);
+#else
+	bits_combine_scalar<Or>(dst, src, n);
+#endif
+}
+
+//! @}
+
+//! @name memory kernels
+//! @{
+
+//! copies bytes with non-temporal stores which bypass the cache.
+//!
+//! Used for copies larger than the working set so that they don't evict it.
+//! Ranges must not overlap. Platforms without non-temporal stores fall back to memcpy().
+inline void mem_cpy_non_temporal(void* dst, const void* src, std::size_t bytes) noexcept
+{
+#if defined(TYPED_COUNT_SIMD_X86)
+	constexpr std::size_t block = 64;
+	auto d = static_cast<unsigned char*>(dst);
+	auto s = static_cast<const unsigned char*>(src);
+
+	// Streaming stores need an aligned destination.
+	const std::size_t head = (16 - (reinterpret_cast<std::uintptr_t>(d) & 15)) & 15;
+	if (bytes < head + block)
+	{
+		std::memcpy(d, s, bytes);
+		return;
+	}
+	std::memcpy(d, s, head);
+	d += head;
+	s += head;
+	bytes -= head;
+
+	for (; bytes >= block; bytes -= block, d += block, s += block)
+	{
+		const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+		const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+		const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+		const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d), v0);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), v1);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), v2);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), v3);
+	}
+	// Streaming stores are weakly ordered. Makes them visible before returning.
+	_mm_sfence();
+	std::memcpy(d, s, bytes);
+#else
+	std::memcpy(dst, src, bytes);
+#endif
+}
+
+//! @}
+
+}
@@ -0,0 +1,343 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+//! @addtogroup utilities
+//! @{
+
+//! Null-terminated string of CharT with a typed length
+//!
+//! Its length and capacity are count_of<CharT>, so a typed_string<char> can't be sized by
+//! a wchar_count. Up to InlineCapacity chars are stored inside the string without allocating.
+//! That is 23 chars, 11 wchar_t on Windows and 5 wchar_t elsewhere by default. Longer strings
+//! are allocated from a memory resource, which is the heap by default and could be a
+//! typed_arena. Appends grow the capacity geometrically.
+//! A copy allocates from the same resource as the source. A move takes over the buffer if
+//! both strings use the same resource and copies otherwise.
+//! Allocation failures throw std::bad_alloc.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! typed_string<char> name{ "conn-" };
+//! name += safe_array<const char>(id, idLen);		// no allocation while it fits 23 chars
+//! safe_array<const char> view = name;				// without the terminator
+//! puts(name.c_str());
+//! @endcode
+template <typename CharT, std::size_t InlineCapacity = 24 / sizeof(CharT) - 1>
+class typed_string
+{
+	static_assert(std::is_trivially_copyable_v<CharT> && !std::is_const_v<CharT>);
+	static_assert(InlineCapacity > 0);
+
+	using count_t = count_of<CharT>;
+
+	std::pmr::memory_resource* resource_;
+	std::size_t size_ = 0;
+	std::size_t capacity_ = InlineCapacity;	//!< capacity without the terminator.
+	union
+	{
+		CharT* heap_;
+		CharT inline_[InlineCapacity + 1];
+	};
+
+public:
+	//! creates an empty string.
+	explicit typed_string(std::pmr::memory_resource* resource = std::pmr::new_delete_resource()) noexcept
+		: resource_(resource)
+	{
+		inline_[0] = CharT();
+	}
+
+	//! copies chars of a view. The view may contain null chars.
+	explicit typed_string(safe_array<const CharT> chars, std::pmr::memory_resource* resource = std::pmr::new_delete_resource())
+		: typed_string(resource)
+	{
+		append(chars);
+	}
+
+	//! copies a null-terminated string.
+	explicit typed_string(const CharT* psz, std::pmr::memory_resource* resource = std::pmr::new_delete_resource())
+		: typed_string(resource)
+	{
+		append(psz);
+	}
+
+	typed_string(const typed_string& other)
+		: typed_string(other.view(), other.resource_)
+	{}
+
+	typed_string(typed_string&& other) noexcept
+		: resource_(other.resource_)
+	{
+		inline_[0] = CharT();
+		steal(other);
+	}
+
+	typed_string& operator =(const typed_string& other)
+	{
+		if (this != &other)
+		{
+			assign(other.view());
+		}
+		return *this;
+	}
+
+	typed_string& operator =(typed_string&& other)
+	{
+		if (this != &other)
+		{
+			if (resource_ == other.resource_ || *resource_ == *other.resource_)
+			{
+				deallocate();
+				steal(other);
+			}
+			else
+			{
+				assign(other.view());
+			}
+		}
+		return *this;
+	}
+
+	~typed_string()
+	{
+		deallocate();
+	}
+
+	//! returns the length without the terminator.
+	count_t count() const noexcept
+	{
+		return count_t(size_);
+	}
+
+	//! returns chars which fit without reallocating.
+	count_t capacity() const noexcept
+	{
+		return count_t(capacity_);
+	}
+
+	//! returns the number of chars stored without allocating.
+	static constexpr count_t inline_capacity() noexcept
+	{
+		return count_t(InlineCapacity);
+	}
+
+	bool empty() const noexcept
+	{
+		return size_ == 0;
+	}
+
+	//! true if the chars are stored inside the string.
+	bool is_inline() const noexcept
+	{
+		return capacity_ == InlineCapacity;
+	}
+
+	const CharT* c_str() const noexcept
+	{
+		return data();
+	}
+
+	CharT* data() noexcept
+	{
+		return is_inline() ? inline_ : heap_;
+	}
+
+	const CharT* data() const noexcept
+	{
+		return is_inline() ? inline_ : heap_;
+	}
+
+	//! returns a view of the chars without the terminator.
+	safe_array<const CharT> view() const noexcept
+	{
+		return { data(), count() };
+	}
+
+	operator safe_array<const CharT>() const noexcept
+	{
+		return view();
+	}
+
+	CharT& operator[](count_t idx)
+	{
+		return safe_array<CharT>(data(), count())[idx];
+	}
+
+	const CharT& operator[](count_t idx) const
+	{
+		return view()[idx];
+	}
+
+	std::pmr::memory_resource* resource() const noexcept
+	{
+		return resource_;
+	}
+
+	//! makes room for count chars without reallocating.
+	void reserve(count_t count)
+	{
+		if (count.to_size() > capacity_)
+		{
+			reallocate(count.to_size());
+		}
+	}
+
+	void clear() noexcept
+	{
+		size_ = 0;
+		data()[0] = CharT();
+	}
+
+	//! appends chars of a view, which may be a part of this string.
+	typed_string& append(safe_array<const CharT> chars)
+	{
+		const std::size_t n = chars.count().to_size();
+		const CharT* src = chars.data();
+		if (n > capacity_ - size_)
+		{
+			// A view of this string moves with the chars.
+			const CharT* old = data();
+			const bool aliased = !std::less<const CharT*>()(src, old) && std::less<const CharT*>()(src, old + size_);
+			grow(n);
+			if (aliased)
+			{
+				src = data() + (src - old);
+			}
+		}
+		CharT* p = data();
+		std::memmove(p + size_, src, n * sizeof(CharT));
+		size_ += n;
+		p[size_] = CharT();
+		return *this;
+	}
+
+	//! appends a null-terminated string.
+	typed_string& append(const CharT* psz)
+	{
+		return append(safe_array<const CharT>(psz, str_len_s(psz)));
+	}
+
+	void push_back(CharT c)
+	{
+		append(safe_array<const CharT>(&c, 1));
+	}
+
+	typed_string& operator +=(safe_array<const CharT> chars)
+	{
+		return append(chars);
+	}
+
+	typed_string& operator +=(const CharT* psz)
+	{
+		return append(psz);
+	}
+
+	typed_string& operator +=(CharT c)
+	{
+		push_back(c);
+		return *this;
+	}
+
+	//! replaces the chars with chars of a view.
+	typed_string& assign(safe_array<const CharT> chars)
+	{
+		if (chars.count().to_size() > capacity_)
+		{
+			typed_string copy(chars, resource_);
+			deallocate();
+			steal(copy);
+			return *this;
+		}
+		CharT* p = data();
+		std::memmove(p, chars.data(), chars.count().to_byte_count());
+		size_ = chars.count().to_size();
+		p[size_] = CharT();
+		return *this;
+	}
+
+	friend bool operator ==(const typed_string& lhs, safe_array<const CharT> rhs) noexcept
+	{
+		return lhs.size_ == rhs.count().to_size() && std::memcmp(lhs.data(), rhs.data(), lhs.size_ * sizeof(CharT)) == 0;
+	}
+
+	friend bool operator !=(const typed_string& lhs, safe_array<const CharT> rhs) noexcept
+	{
+		return !(lhs == rhs);
+	}
+
+	friend bool operator ==(const typed_string& lhs, const typed_string& rhs) noexcept
+	{
+		return lhs == rhs.view();
+	}
+
+	friend bool operator !=(const typed_string& lhs, const typed_string& rhs) noexcept
+	{
+		return !(lhs == rhs.view());
+	}
+
+private:
+	//! grows the capacity for n more chars at least doubling it.
+	void grow(std::size_t n)
+	{
+		const std::size_t required = size_ + n;
+		reallocate(required > capacity_ * 2 ? required : capacity_ * 2);
+	}
+
+	void reallocate(std::size_t capacity)
+	{
+		auto p = static_cast<CharT*>(resource_->allocate((capacity + 1) * sizeof(CharT), alignof(CharT)));
+		std::memcpy(p, data(), (size_ + 1) * sizeof(CharT));
+		deallocate();
+		heap_ = p;
+		capacity_ = capacity;
+	}
+
+	void deallocate() noexcept
+	{
+		if (!is_inline())
+		{
+			resource_->deallocate(heap_, (capacity_ + 1) * sizeof(CharT), alignof(CharT));
+			capacity_ = InlineCapacity;
+		}
+	}
+
+	//! takes the chars of other and leaves it empty. This string must have no heap buffer.
+	void steal(typed_string& other) noexcept
+	{
+		resource_ = other.resource_;
+		size_ = other.size_;
+		capacity_ = other.capacity_;
+		if (other.is_inline())
+		{
+			std::memcpy(inline_, other.inline_, (other.size_ + 1) * sizeof(CharT));
+		}
+		else
+		{
+			heap_ = other.heap_;
+			other.capacity_ = InlineCapacity;
+		}
+		other.clear();
+	}
+};
+
+//! @}
+
+//! @addtogroup typedefs
+//! @{
+
+using typed_wstring = typed_string<wchar_t>;
+
+//! @}
+
+}
@@ -0,0 +1,306 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "typed_count_core.h"
+
+namespace typed_count
+{
+
+namespace detail
+{
+
+//! replacement of invalid sequences.
+constexpr char32_t replacement_char = 0xFFFD;
+
+//! decodes one UTF-8 sequence of 1 to n bytes at p. n must be at least 1.
+//!
+//! Returns bytes consumed. An invalid sequence decodes to replacement_char and consumes its
+//! maximal valid prefix but at least one byte, like Unicode recommends. Overlong forms,
+//! surrogates and code points above U+10FFFF are invalid.
+inline std::size_t decode_utf8(const unsigned char* p, std::size_t n, char32_t& cp) noexcept
+{
+	const unsigned char lead = p[0];
+	std::size_t len;
+	char32_t c;
+	unsigned char lo = 0x80;
+	unsigned char hi = 0xBF;
+	if (lead < 0x80)
+	{
+		cp = lead;
+		return 1;
+	}
+	else if (lead >= 0xC2 && lead <= 0xDF)
+	{
+		len = 2;
+		c = lead & 0x1F;
+	}
+	else if (lead >= 0xE0 && lead <= 0xEF)
+	{
+		len = 3;
+		c = lead & 0x0F;
+		lo = lead == 0xE0 ? 0xA0 : 0x80;
+		hi = lead == 0xED ? 0x9F : 0xBF;
+	}
+	else if (lead >= 0xF0 && lead <= 0xF4)
+	{
+		len = 4;
+		c = lead & 0x07;
+		lo = lead == 0xF0 ? 0x90 : 0x80;
+		hi = lead == 0xF4 ? 0x8F : 0xBF;
+	}
+	else
+	{
+		cp = replacement_char;
+		return 1;
+	}
+
+	for (std::size_t i = 1; i < len; ++i)
+	{
+		if (i >= n || p[i] < lo || p[i] > hi)
+		{
+			cp = replacement_char;
+			return i;
+		}
+		c = (c << 6) | (p[i] & 0x3F);
+		lo = 0x80;
+		hi = 0xBF;
+	}
+	cp = c;
+	return len;
+}
+
+//! decodes one UTF-16 or UTF-32 code point of 1 to n units at p. n must be at least 1.
+//!
+//! Returns units consumed. Unpaired surrogates and values above U+10FFFF decode to replacement_char.
+template <typename WideT>
+std::size_t decode_wide(const WideT* p, std::size_t n, char32_t& cp) noexcept
+{
+	const std::uint32_t unit = static_cast<std::uint32_t>(p[0]);
+	if constexpr (sizeof(WideT) == 2)
+	{
+		if (unit >= 0xD800 && unit <= 0xDBFF && n > 1)
+		{
+			const std::uint32_t low = static_cast<std::uint32_t>(p[1]);
+			if (low >= 0xDC00 && low <= 0xDFFF)
+			{
+				cp = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+				return 2;
+			}
+		}
+	}
+	cp = (unit >= 0xD800 && unit <= 0xDFFF) || unit > 0x10FFFF ? replacement_char : unit;
+	return 1;
+}
+
+//! returns UTF-8 bytes of a code point.
+constexpr std::size_t utf8_units(char32_t cp) noexcept
+{
+	return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+//! returns wide units of a code point.
+template <typename WideT>
+constexpr std::size_t wide_units(char32_t cp) noexcept
+{
+	return sizeof(WideT) == 2 && cp >= 0x10000 ? 2 : 1;
+}
+
+inline void encode_utf8(char32_t cp, char* p) noexcept
+{
+	switch (utf8_units(cp))
+	{
+	case 1:
+		p[0] = static_cast<char>(cp);
+		break;
+	case 2:
+		p[0] = static_cast<char>(0xC0 | (cp >> 6));
+		p[1] = static_cast<char>(0x80 | (cp & 0x3F));
+		break;
+	case 3:
+		p[0] = static_cast<char>(0xE0 | (cp >> 12));
+		p[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		p[2] = static_cast<char>(0x80 | (cp & 0x3F));
+		break;
+	default:
+		p[0] = static_cast<char>(0xF0 | (cp >> 18));
+		p[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+		p[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		p[3] = static_cast<char>(0x80 | (cp & 0x3F));
+		break;
+	}
+}
+
+template <typename WideT>
+void encode_wide(char32_t cp, WideT* p) noexcept
+{
+	if (wide_units<WideT>(cp) == 2)
+	{
+		p[0] = static_cast<WideT>(0xD800 + ((cp - 0x10000) >> 10));
+		p[1] = static_cast<WideT>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+	}
+	else
+	{
+		p[0] = static_cast<WideT>(cp);
+	}
+}
+
+//! returns wide units needed for a UTF-8 string.
+template <typename WideT>
+std::size_t required_wide_units(const char* src, std::size_t n) noexcept
+{
+	std::size_t required = 0;
+	std::size_t i = 0;
+	while (i < n)
+	{
+		const std::size_t run = ascii_prefix(src + i, n - i);
+		i += run;
+		required += run;
+		if (i == n)
+		{
+			break;
+		}
+		char32_t cp;
+		i += decode_utf8(reinterpret_cast<const unsigned char*>(src + i), n - i, cp);
+		required += wide_units<WideT>(cp);
+	}
+	return required;
+}
+
+//! converts UTF-8 to UTF-16 or UTF-32 and returns units written.
+//!
+//! Stops before a code point which doesn't fit in capacity.
+template <typename WideT>
+std::size_t utf8_to_wide(const char* src, std::size_t n, WideT* dst, std::size_t capacity) noexcept
+{
+	std::size_t i = 0;
+	std::size_t written = 0;
+	while (i < n)
+	{
+		const std::size_t room = capacity - written;
+		const std::size_t run = widen_ascii(src + i, n - i < room ? n - i : room, dst + written);
+		i += run;
+		written += run;
+		if (i == n || written == capacity)
+		{
+			break;
+		}
+		char32_t cp;
+		const std::size_t len = decode_utf8(reinterpret_cast<const unsigned char*>(src + i), n - i, cp);
+		if (capacity - written < wide_units<WideT>(cp))
+		{
+			break;
+		}
+		encode_wide(cp, dst + written);
+		i += len;
+		written += wide_units<WideT>(cp);
+	}
+	return written;
+}
+
+//! returns UTF-8 bytes needed for a UTF-16 or UTF-32 string.
+template <typename WideT>
+std::size_t required_utf8_units(const WideT* src, std::size_t n) noexcept
+{
+	std::size_t required = 0;
+	std::size_t i = 0;
+	while (i < n)
+	{
+		const std::size_t run = narrow_ascii<false>(src + i, n - i, nullptr);
+		i += run;
+		required += run;
+		if (i == n)
+		{
+			break;
+		}
+		char32_t cp;
+		i += decode_wide(src + i, n - i, cp);
+		required += utf8_units(cp);
+	}
+	return required;
+}
+
+//! converts UTF-16 or UTF-32 to UTF-8 and returns bytes written.
+//!
+//! Stops before a code point which doesn't fit in capacity.
+template <typename WideT>
+std::size_t wide_to_utf8(const WideT* src, std::size_t n, char* dst, std::size_t capacity) noexcept
+{
+	std::size_t i = 0;
+	std::size_t written = 0;
+	while (i < n)
+	{
+		const std::size_t room = capacity - written;
+		const std::size_t run = narrow_ascii<true>(src + i, n - i < room ? n - i : room, dst + written);
+		i += run;
+		written += run;
+		if (i == n || written == capacity)
+		{
+			break;
+		}
+		char32_t cp;
+		const std::size_t len = decode_wide(src + i, n - i, cp);
+		if (capacity - written < utf8_units(cp))
+		{
+			break;
+		}
+		encode_utf8(cp, dst + written);
+		i += len;
+		written += utf8_units(cp);
+	}
+	return written;
+}
+
+}
+
+//! @addtogroup utilities
+//! @{
+
+//! returns wchar_t needed to convert a UTF-8 string by utf8_to_wide().
+//!
+//! wchar_t is UTF-16 on Windows and UTF-32 elsewhere. A null char is converted like any
+//! other char, so add 1_wch for a terminator if src doesn't include it. ASCII runs are
+//! counted 16 or 32 bytes at a time.
+//!
+//! <h4>Usage</h4>
+//! @code{.cpp}
+//! safe_array<const char> utf8{ name, str_len_s(name) + 1_ch };	// with the terminator
+//! auto wide = make_unique_safe_array(required_wide_count(utf8));
+//! utf8_to_wide(utf8, wide);
+//! @endcode
+inline wchar_count required_wide_count(safe_array<const char> src) noexcept
+{
+	return wchar_count(detail::required_wide_units<wchar_t>(src.data(), src.count().to_size()));
+}
+
+//! converts a UTF-8 string to wchar_t and returns wchar_t written.
+//!
+//! Invalid sequences become U+FFFD. Stops before a code point which doesn't fit in dst, so
+//! the result is less than required_wide_count() only if dst is too small. ASCII runs are
+//! converted by SSE2 or AVX2 where available.
+inline wchar_count utf8_to_wide(safe_array<const char> src, safe_array<wchar_t> dst) noexcept
+{
+	return wchar_count(detail::utf8_to_wide(src.data(), src.count().to_size(), dst.data(), dst.count().to_size()));
+}
+
+//! returns chars needed to convert a wchar_t string by wide_to_utf8().
+//!
+//! A null wchar_t is converted like any other wchar_t.
+inline char_count required_utf8_count(safe_array<const wchar_t> src) noexcept
+{
+	return char_count(detail::required_utf8_units(src.data(), src.count().to_size()));
+}
+
+//! converts a wchar_t string to UTF-8 and returns chars written.
+//!
+//! Unpaired surrogates become U+FFFD. Stops before a code point which doesn't fit in dst,
+//! so the result is less than required_utf8_count() only if dst is too small.
+inline char_count wide_to_utf8(safe_array<const wchar_t> src, safe_array<char> dst) noexcept
+{
+	return char_count(detail::wide_to_utf8(src.data(), src.count().to_size(), dst.data(), dst.count().to_size()));
+}
+
+//! @}
+
+}
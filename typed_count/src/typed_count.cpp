@@ -1,8 +1,61 @@
 ﻿#include "typed_count.h"
+#include "typed_arena.h"
+#include "buffer_pool.h"
+#include "aligned_array.h"
+#include "page_units.h"
+#include "mapped_file.h"
+#include "chunked_reader.h"
+#include "iovec_builder.h"
+#include "atomic_count.h"
+#include "memory_budget.h"
+#include "parallel_algorithms.h"
+#include "small_buffer.h"
+#include "ring_buffer.h"
+#include "utf_convert.h"
+#include "typed_string.h"
+#include "alloc_tracking.h"
+#include "typed_count_format.h"
+#include "count_column.h"
+#include "bit_view.h"
+#include "numa_resource.h"
+#include "async_io.h"
+
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
 
 using namespace std;
 using namespace typed_count;
 
+namespace tag
+{
+TYPED_COUNT_ALLOC_TAG(demo);
+}
+
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+// Sends a message through a pipe in partial writes and reads it back in another task.
+io_task send_message(io_loop& loop, int fd, safe_array<const std::byte> message)
+{
+	while (message)
+	{
+		message += co_await async_write(loop, fd, message);
+	}
+	close(fd);
+}
+
+io_task receive_message(io_loop& loop, int fd, byte_count& received)
+{
+	fixed_size_array<std::byte, 4> chunk;
+	byte_count n;
+	while ((n = co_await async_read(loop, fd, chunk)) > 0_bt)
+	{
+		received += n;
+	}
+	close(fd);
+}
+#endif
+
 int main()
 {
 	const wchar_t* pwsz = L"ABCD";
@@ -51,6 +104,80 @@ int main()
 	cout << "pages to kb = " << no_of_pages.to_count_of<Kb>() << endl;
 	cout << "pages to mb = " << no_of_pages.to_count_of<Mb>() << endl;
 	cout << "pages to bytes = " << no_of_pages.to_count_of<byte>() << endl;
+	// conversion ratios are reduced at compile time and the intermediate doesn't overflow.
+	static_assert(no_of_pages.to_count_of<Kb>().to_size() == 1024);
+	static_assert(mb_count(SIZE_MAX).to_count_of<Gb>().to_size() == SIZE_MAX / 1024);
+	// format_to() formats without an ostream or allocation, like std::to_chars(). This will print 1 MiB.
+	fixed_size_array<char, formatted_count_max.to_size()> formatted;
+	const char_count formattedLen = format_to(formatted, no_of_pages, count_style::human);
+	printf("pages in human units = %.*s\n", formattedLen.to_int(), static_cast<char*>(formatted));
+	assert(format_to(formatted, 1536_kb, count_style::human) == 7_ch && formatted[0_ch] == '1' && formatted[4_ch] == 'M');
+
+	// count32_of<T> and count16_of<T> store a count in fewer bits for large arrays of lengths.
+	vector<char_count32> recordLengths{ char_count32(3), char_count32(5) };
+	char_count totalLength;
+	for (char_count32 length : recordLengths)
+	{
+		totalLength += length;				// widening is implicit.
+	}
+	assert(totalLength == 8_ch);
+	char_count32 narrowed;
+	assert(narrow_count_s(narrowed, totalLength) == 0 && narrowed == 8_ch);	// narrowing is explicit or checked.
+	// to_count_of() widens the result only when it may not fit.
+	static_assert(is_same_v<decltype(wchar_count16(1).to_count_of<byte>()), byte_count32>);
+
+	// safe_array and fixed_size_array have raw pointer iterators, so range-for and std algorithms
+	// see through them. Indexes are checked by a bounds check policy.
+	fixed_size_array<int, 4> unsortedInts{ { 4, 2, 3, 1 } };
+	sort(unsortedInts.begin(), unsortedInts.end());
+	int expectedInt = 1;
+	for (int value : safe_array<const int>(unsortedInts))
+	{
+		assert(value == expectedInt++);
+	}
+	safe_array<int, bounds_check_always> checkedInts = unsortedInts;
+	// The index is read through volatile like an index from input, so the compiler doesn't
+	// warn about an access it can prove is out of bounds.
+	volatile std::size_t outOfRange = 4;
+	try
+	{
+		checkedInts[count_of<int>(outOfRange)] = 0;
+		assert(false);
+	}
+	catch (const out_of_range&)
+	{
+	}
+	for (auto i : checkedInts.indices())
+	{
+		checkedInts[i] *= 2;
+	}
+	assert(unsortedInts[count_of<int>(3)] == 8);
+
+	// subarray(), first(), last(), drop_back() and split_at() slice a safe_array without copying.
+	safe_array<const char> packet{ "HDRpayloadCRC", 13 };
+	auto [packetHeader, packetRest] = packet.split_at(3_ch);
+	auto packetPayload = packetRest.drop_back(3_ch);
+	assert(packetHeader.count() == 3_ch && packetPayload.count() == 7_ch && *packet.last(3_ch) == 'C');
+	assert(packet.subarray(3_ch, 7_ch).data() == packetPayload.data() && packet.first(1_ch)[0_ch] == 'H');
+
+	// checked_count_of throws on overflow and saturating_count_of clamps. Both convert to plain counts.
+	checked_count_of<char> received{ 4 };
+	try
+	{
+		received -= checked_count_of<char>(5);
+		assert(false);
+	}
+	catch (const overflow_error&)
+	{
+	}
+	saturating_count_of<char> remaining{ 4 };
+	remaining -= 5_ch;
+	assert(remaining == 0_ch);
+	char_count plainReceived = received;
+	assert(plainReceived == 4_ch);
+	// Function templates deducing T from a count take counts of any Rep and policy.
+	auto pReceived = make_unique_safe_array(received);
+	assert(pReceived.count() == 4_ch && round_up_to<Kb>(count32_of<byte>(1)) == 1_kb .to_count_of<byte>());
 
 	// safe array for constant string.
 	safe_array<const wchar_t> cwsz{ L"EFGHI", wcslen(L"EFGHI") + 1 };
@@ -70,6 +197,22 @@ int main()
 	// both fixed_size_array and safe_array provides count() member function.
 	assert(cwsz2.count() == wsz2.count() && wsz2.count() == 6_wch);
 
+	// str_nlen_s() never scans beyond count() even if there is no null terminator.
+	fixed_size_array<const char, 4> unterminated{ 'W', 'X', 'Y', 'Z' };
+	assert(str_nlen_s(unterminated) == 4_ch);
+	assert(str_nlen_s(wsz2) == 5_wch);
+
+	// mem_cpy_s() and its siblings take typed counts and fail instead of overrunning buffers.
+	fixed_size_array<wchar_t, 6> wbuf;
+	assert(mem_cpy_s(wbuf, cwsz, cwsz.count()) == 0);
+	int wbufDiff = 1;
+	assert(mem_cmp_s(wbuf, cwsz2, wbuf.count(), wbufDiff) == 0 && wbufDiff == 0);
+	assert(mem_cmp_s(wbuf, cwsz2, 7_wch, wbufDiff) == ERANGE);
+	assert(mem_cpy_s(wbuf, cwsz, 7_wch) == ERANGE);
+	assert(mem_set_s(wbuf, L'\0', 2_wch) == 0 && wbuf[1_wch] == L'\0');
+	// fixed_size_array sizes are checked at compile time.
+	mem_cpy_s(wbuf, cwsz2);
+
 	// can define constant safe_array if you don't plan to modify the pointer itself.
 	const safe_array<char> pOrgData{new char[10], 10};
 	char_count i = 0_ch;
@@ -103,5 +246,233 @@ int main()
 	}
 	pNameCopy[i] = '\0';
 	cout << pNameCopy.data() << endl;
+	delete[] pNameCopy;
+
+	// unique_safe_array owns the array and deletes it automatically.
+	// make_safe_array_for_overwrite() doesn't initialize elements of trivial types.
+	auto pOwned = make_safe_array_for_overwrite(str_len_s(name) + 1_ch);
+	str_cpy_s(name, pOwned.data(), pOwned.count());
+	// converts to a non-owning safe_array view.
+	safe_array<const char> ownedView = pOwned;
+	assert(str_nlen_s(ownedView) == 4_ch);
+	// unique_safe_array is move-only.
+	auto pMoved = std::move(pOwned);
+	assert(!pOwned && pMoved.count() == 5_ch);
+
+	// Tagged allocations are accounted per tag when TYPED_COUNT_ALLOC_TRACKING is 1 and are plain allocations otherwise.
+	{
+		auto pTagged = make_unique_safe_array<tag::demo>(16_ch);
+		static_assert(sizeof(pTagged) == sizeof(safe_array<char>));
+		for (const alloc_tag_stats& stats : alloc_snapshot())
+		{
+			printf("%s: %zu allocations, %zu bytes live\n", stats.name, stats.allocations, stats.live_bytes.to_size());
+		}
+	}
+
+	// typed_string keeps short strings inline and measures them in typed counts.
+	typed_string<char> nameString{ psz };
+	nameString += "-01";
+	assert(nameString.is_inline() && nameString.count() == 7_ch && str_nlen_s(nameString) == 7_ch);
+	typed_wstring wideString{ pwsz };
+	assert(wideString.count() == wszlen && wideString[0_wch] == L'A');
+
+	// typed_arena hands out safe arrays from chunks sized in any unit.
+	typed_arena arena{ 4_pg };
+	safe_array<wchar_t> pArenaWsz = arena.allocate(str_len_s(pwsz) + 1_wch);
+	str_cpy_s(pwsz, pArenaWsz, pArenaWsz.count());
+	{
+		// typed_arena is also a std::pmr::memory_resource.
+		std::pmr::vector<int> ints{ 100, 1, &arena };
+		assert(arena.allocated() >= pArenaWsz.count().to_count_of<byte>() + count_of<int>(100).to_count_of<byte>());
+	}
+	// frees everything at once.
+	arena.reset();
+	assert(arena.allocated() == 0_bt);
+
+	// buffer_pool recycles buffers of one unit like 8KB pages.
+	auto& pagePool = buffer_pool<Page>::instance();
+	safe_array<byte> pPage = pagePool.acquire();
+	assert(pPage.count() == 1_pg .to_count_of<byte>());
+	pagePool.release(pPage);
+	{
+		// pooled_buffer returns the buffer to the pool automatically.
+		pooled_buffer<Page> pRecycled;
+		assert(pagePool.stats().hits >= 1 && pagePool.stats().bytes_allocated == pRecycled.count());
+	}
+
+	// make_aligned_safe_array() aligns arrays like for SIMD or O_DIRECT.
+	auto pAligned = make_aligned_safe_array(1_kb .to_count_of<byte>(), 4_kb .to_count_of<byte>());
+	assert(reinterpret_cast<uintptr_t>(pAligned.data()) % 4096 == 0);
+	// make_huge_page_safe_array() rounds up to huge pages and falls back when they aren't available.
+	auto pHuge = make_huge_page_safe_array(128_kb .to_count_of<byte>(), huge_page_mode::explicit_2mb);
+	assert(pHuge.get_deleter().mapped >= 2_mb .to_count_of<byte>() || pHuge.get_deleter().backing == page_backing::regular);
+
+	// os_page_count and huge_page_count use the page sizes of the machine queried at the first use.
+	cout << "os page = " << os_page_count(1).to_byte_count() << " bytes, huge page = " << huge_page_count(1).to_byte_count() << " bytes" << endl;
+	// round_up_to() and round_down_to() round to a multiple of a unit with mask arithmetic.
+	byte_count mmapLength = round_up_to<OsPage>(1_bt);
+	assert(mmapLength == os_page_count(1).to_count_of<byte>());
+	assert(round_down_to<Kb>(3000_bt) == 2_kb .to_count_of<byte>());
+
+	// map_file() maps a file as safe_array<const T> without copying it.
+	if (FILE* fp = fopen("typed_count_demo.tmp", "wb"))
+	{
+		fputs("EFGHI", fp);
+		fclose(fp);
+		{
+			auto mapped = map_file<char>("typed_count_demo.tmp");
+			mapped.advise(map_advice::sequential);
+			assert(mapped.count() == 5_ch && mapped.mapped_pages() == os_page_count(1));
+			// map_range() maps a window of the file.
+			auto window = mappable_file("typed_count_demo.tmp").map_range(1_ch, 3_ch);
+			int windowDiff = 1;
+			assert(mem_cmp_s(window, mapped.get() + 1_ch, 3_ch, windowDiff) == 0 && windowDiff == 0);
+		}
+		{
+			// chunked_reader streams a file in chunks of one unit while the next chunk is read ahead.
+			chunked_reader<Page> reader{ "typed_count_demo.tmp" };
+			auto chunk = reader.next();
+			assert(chunk.count() == 5_bt && !reader.next());
+			// Chunks can be any count of the unit like 64_kb.
+			chunked_reader<Kb> wideReader{ "typed_count_demo.tmp", 64_kb };
+			assert(wideReader.chunk_size() == (64_kb).to_count_of<std::byte>() && wideReader.next().count() == 5_bt);
+		}
+		remove("typed_count_demo.tmp");
+	}
+
+	// atomic_count_of and sharded_count_of keep the unit of counters shared by threads.
+	atomic_count_of<Page> dirtyPages;
+	dirtyPages.fetch_add(page_count(2), memory_order_relaxed);
+	assert(dirtyPages.to_count_of<Kb>() == 16_kb);
+	sharded_byte_count allocatedBytes;
+	allocatedBytes += 2_mb .to_count_of<byte>();
+	allocatedBytes -= 1_mb .to_count_of<byte>();
+	assert(allocatedBytes.to_count_of<Mb>() == 1_mb);
+
+	// memory_budget enforces a quota in any unit without a lock. A child budget also counts against its parent.
+	memory_budget processBudget{ 1_mb };
+	memory_budget tenantBudget{ 64_kb, &processBudget };
+	const bool reserved = tenantBudget.try_reserve(48_kb);
+	const bool overReserved = tenantBudget.try_reserve(32_kb);
+	assert(reserved && !overReserved);
+	assert(processBudget.used() == 48_kb .to_count_of<byte>());
+	tenantBudget.release(48_kb);
+	{
+		// An arena over its budget throws std::bad_alloc instead of growing.
+		typed_arena tenantArena{ 32_kb, tenantBudget };
+		tenantArena.allocate(1_kb .to_count_of<byte>());
+		assert(tenantBudget.used() == 32_kb .to_count_of<byte>());
+	}
+	assert(processBudget.used() == 0_bt);
+
+	// small_buffer keeps small temporaries inline and spills large ones to the heap or an arena.
+	small_buffer<wchar_t> wszCopy{ wszlen + 1_wch };
+	str_cpy_s(pwsz, wszCopy.data(), wszCopy.count());
+	assert(wszCopy.is_inline() && wszCopy[0_wch] == L'A');
+	{
+		typed_arena scratchArena{ 16_pg };
+		small_buffer<char, 256> scratch{ 8_kb .to_count_of<char>(), &scratchArena };
+		assert(!scratch.is_inline() && scratch.get().count() == 8192_ch);
+	}
+
+	// utf8_to_wide() and wide_to_utf8() convert between char and wchar_t with typed counts.
+	safe_array<const char> utf8Name{ "caf\xC3\xA9", 5 };
+	auto wideName = make_unique_safe_array(required_wide_count(utf8Name));
+	assert(wideName.count() == 4_wch && utf8_to_wide(utf8Name, wideName) == 4_wch && wideName[3_wch] == L'\u00E9');
+	fixed_size_array<char, 8> utf8Back;
+	assert(required_utf8_count(wideName) == 5_ch && wide_to_utf8(wideName, utf8Back) == 5_ch);
+
+	// Rings pass batches between threads with typed counts. Capacity is rounded up to a power of two.
+	spsc_ring<char> byteStream{ 1000_ch };
+	assert(byteStream.capacity() == 1024_ch);
+	assert(byteStream.try_push_n(safe_array<const char>("GET /", 5)) == 5_ch);
+	fixed_size_array<char, 3> parsed;
+	assert(byteStream.try_pop_n(safe_array<char>(parsed)) == 3_ch && parsed[2_ch] == 'T' && byteStream.size() == 2_ch);
+
+	// count_column stores counts as plain integers and sums, scans and converts them as vectors.
+	count_column<char, std::uint32_t> fragmentLengths{ char_count32(100), char_count32(28), char_count32(4000) };
+	assert(fragmentLengths.sum() == 4128_ch && fragmentLengths.max() == char_count32(4000));
+	const auto fragmentOffsets = fragmentLengths.prefix_sum();
+	assert(fragmentOffsets[count_of<char_count>(2)] == 128_ch);
+	assert(fragmentLengths.convert_all<wchar_t>().sum() == (4128_ch).to_count_of<wchar_t>());
+
+	// bit_count is 1/8 of a byte. Conversions to wider units round down, ceil_count_of() rounds up.
+	assert(ceil_count_of<std::byte>(13_bit) == 2_bt && (13_bit).to_count_of<std::byte>() == 1_bt);
+	fixed_size_array<std::uint64_t, 2> flagWords{};
+	bit_view flags{ safe_array<std::uint64_t>(flagWords), 100_bit };
+	flags.set(70_bit);
+	flags.set(99_bit);
+	assert(flags.popcount() == 2_bit && flags.find_first_set() == 70_bit && flags.find_first_set(71_bit) == 99_bit);
+
+	// Arrays allocated from a memory resource go back to it when the owning array is destroyed.
+	numa_resource localNode{ 0 };
+	auto scanRows = make_safe_array_for_overwrite(count_of<std::uint64_t>(4096), &localNode);
+	scanRows[count_of<std::uint64_t>(0)] = 1;
+	auto sharedTable = numa_resource::interleaved();
+	auto lookup = make_unique_safe_array(32_kb .to_count_of<std::uint32_t>(), &sharedTable);
+	assert(lookup.count() == count_of<std::uint32_t>(8192) && lookup[count_of<std::uint32_t>(8191)] == 0);
+
+#if defined(__cpp_lib_span)
+	// safe_array and std::span convert to each other in C++20.
+	int spanInts[3] = { 1, 2, 3 };
+	std::span<int> intSpan{ spanInts };
+	safe_array<const int> fromSpan = intSpan;
+	std::span<const int> backToSpan = fromSpan;
+	assert(fromSpan.count() == count_of<int>(3) && backToSpan.size() == 3 && backToSpan[2] == 3);
+#endif
+
+	// Parallel algorithms split a safe_array into grains of elements or of a working set like 64_kb.
+	std::vector<std::uint32_t> samples(100000, 3);
+	safe_array<std::uint32_t> sampleArray(samples.data(), samples.size());
+	parallel_for_each(sampleArray, [](std::uint32_t& sample) { sample *= 2; }, 64_kb);
+	assert(parallel_reduce(sampleArray, std::uint64_t(0), std::plus<>(), count_of<std::uint32_t>(4096)) == 600000);
+
+#if !defined(_WIN32)
+	// iovec_builder gathers fragments for one writev() without copying them into a buffer.
+	int fds[2];
+	if (pipe(fds) == 0)
+	{
+		fixed_size_array<char, 2> frameHeader{ { 'F', ':' } };
+		iovec_builder<> frame;
+		frame.add(frameHeader).add(safe_array<const char>("payload", 7));
+		assert(frame.size() == count_of<iovec>(2) && frame.total() == 9_bt);
+		write_all(fds[1], frame);
+		close(fds[1]);
+
+		fixed_size_array<char, 16> received;
+		assert(read_all(fds[0], safe_array<char>(received)) == 9_ch);
+		int receivedDiff = 1;
+		assert(mem_cmp_s(safe_array<const char>(received), safe_array<const char>("F:payload", 9), 9_ch, receivedDiff) == 0 && receivedDiff == 0);
+		close(fds[0]);
+	}
+
+	// A full builder throws instead of writing past its entries.
+	iovec_builder<1> single;
+	single.add(safe_array<const char>("a", 1));
+	bool overflowed = false;
+	try
+	{
+		single.add(safe_array<const char>("b", 1));
+	}
+	catch (const std::length_error&)
+	{
+		overflowed = true;
+	}
+	assert(overflowed && single.full() && single.total() == 1_bt);
+#endif
+
+#if defined(__linux__) && defined(__cpp_impl_coroutine)
+	// Coroutines await reads and writes on io_uring and get typed byte counts back.
+	if (pipe(fds) == 0)
+	{
+		const char message[] = "coroutine";
+		byte_count received;
+		io_loop loop;
+		loop.spawn(receive_message(loop, fds[0], received));
+		loop.spawn(send_message(loop, fds[1], { reinterpret_cast<const std::byte*>(message), 9 }));
+		loop.run();
+		assert(received == 9_bt);
+	}
+#endif
 }
 